@@ -0,0 +1,209 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#include "checkpoint.h"
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+namespace {
+const char *STATE_FILE = "state.txt";
+
+std::string CheckpointPath(const std::string &dir, const std::string &name) {
+  return (std::filesystem::path(dir) / name).string();
+}
+}
+
+bool ReadCheckpointState(const std::string &dir, CheckpointState &state) {
+  std::ifstream ifs(CheckpointPath(dir, STATE_FILE));
+  if (!ifs.is_open()) {
+    return false;
+  }
+  std::map<std::string, std::string> fields;
+  std::string line;
+  while (getline(ifs, line)) {
+    auto eq = line.find('=');
+    if (eq != std::string::npos) {
+      fields[line.substr(0, eq)] = line.substr(eq + 1);
+    }
+  }
+  for (auto name : {"nextEpoch", "totalTime", "lossOffset", "weightsOffset", "testLossOffset", "weightsFile"}) {
+    if (fields.find(name) == fields.end()) {
+      OPENFHE_THROW(lbcrypto::config_error, "Checkpoint " + dir + ": state is missing " + std::string(name));
+    }
+  }
+  state.nextEpoch = std::stoul(fields["nextEpoch"]);
+  state.totalTime = std::stod(fields["totalTime"]);
+  state.lossOffset = std::stoll(fields["lossOffset"]);
+  state.weightsOffset = std::stoll(fields["weightsOffset"]);
+  state.testLossOffset = std::stoll(fields["testLossOffset"]);
+  state.batchScheduleState = fields["batchScheduleState"];
+  state.weightsFile = fields["weightsFile"];
+  if (fields.count("weightsPacking") != 0) {
+    state.weightsPacking = fields["weightsPacking"];
+  }
+  return true;
+}
+
+CT LoadCheckpointWeights(const std::string &dir, const CheckpointState &state, const KeyPair &keys) {
+  CT ctWeights;
+  if (!lbcrypto::Serial::DeserializeFromFile(CheckpointPath(dir, state.weightsFile), ctWeights,
+                                             lbcrypto::SerType::BINARY)) {
+    OPENFHE_THROW(lbcrypto::config_error, "Checkpoint " + dir + ": could not read " + state.weightsFile);
+  }
+  if (ctWeights->GetKeyTag() != keys.secretKey->GetKeyTag()) {
+    OPENFHE_THROW(lbcrypto::config_error,
+                  "Checkpoint " + dir + ": weights were encrypted under different keys. "
+                  "Resume with the key store (-K) the run was started with");
+  }
+  return ctWeights;
+}
+
+///////////////////////////////////////////////////////////
+CheckpointWriter::CheckpointWriter(const std::string &dir, const std::string &resumedWeightsFile)
+    : dir(dir), lastWeightsFile(resumedWeightsFile) {
+  std::filesystem::create_directories(dir);
+  // a fresh run into an old checkpoint directory replaces that checkpoint's weights too
+  CheckpointState previous;
+  if (lastWeightsFile.empty() && ReadCheckpointState(dir, previous)) {
+    lastWeightsFile = previous.weightsFile;
+  }
+  worker = std::thread(&CheckpointWriter::Run, this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stop = true;
+  }
+  cv.notify_all();
+  worker.join();
+}
+
+void CheckpointWriter::Submit(const CT &ctWeights, const CheckpointState &state) {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    pendingWeights = ctWeights;
+    pendingState = state;
+    hasPending = true;
+  }
+  cv.notify_all();
+}
+
+void CheckpointWriter::Wait() {
+  std::unique_lock<std::mutex> lock(mtx);
+  cv.wait(lock, [this] { return !hasPending && !writing; });
+}
+
+void CheckpointWriter::Run() {
+  std::unique_lock<std::mutex> lock(mtx);
+  while (true) {
+    cv.wait(lock, [this] { return hasPending || stop; });
+    if (!hasPending) {
+      return;  // stop requested and nothing left to write
+    }
+    CT ctWeights = pendingWeights;
+    CheckpointState state = pendingState;
+    pendingWeights = nullptr;
+    hasPending = false;
+    writing = true;
+
+    lock.unlock();
+    Write(ctWeights, state);
+    lock.lock();
+
+    writing = false;
+    cv.notify_all();
+  }
+}
+
+void CheckpointWriter::DiscardWeights(const std::string &path, const std::string &name) const {
+  // never remove the file the current state.txt still points at
+  if (name != lastWeightsFile) {
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+  }
+}
+
+void CheckpointWriter::Write(const CT &ctWeights, CheckpointState state) {
+  // runs on the writer thread: every failure is reported and the checkpoint skipped, an exception
+  //    here would terminate the training run
+  std::error_code ec;
+  state.weightsFile = "weights_" + std::to_string(state.nextEpoch) + ".bin";
+  std::string weightsPath = CheckpointPath(dir, state.weightsFile);
+  if (!lbcrypto::Serial::SerializeToFile(weightsPath + ".tmp", ctWeights, lbcrypto::SerType::BINARY)) {
+    std::cerr << "Checkpoint: could not write " << weightsPath << ", skipping this checkpoint" << std::endl;
+    return;
+  }
+  std::filesystem::rename(weightsPath + ".tmp", weightsPath, ec);
+  if (ec) {
+    std::cerr << "Checkpoint: could not rename " << weightsPath << ".tmp: " << ec.message()
+              << ", skipping this checkpoint" << std::endl;
+    return;
+  }
+
+  std::string statePath = CheckpointPath(dir, STATE_FILE);
+  {
+    std::ofstream ofs(statePath + ".tmp", std::ios::out | std::ios::trunc);
+    ofs.precision(dbl::max_digits10);
+    ofs << "nextEpoch=" << state.nextEpoch << std::endl
+        << "totalTime=" << state.totalTime << std::endl
+        << "lossOffset=" << state.lossOffset << std::endl
+        << "weightsOffset=" << state.weightsOffset << std::endl
+        << "testLossOffset=" << state.testLossOffset << std::endl
+        << "batchScheduleState=" << state.batchScheduleState << std::endl
+        << "weightsFile=" << state.weightsFile << std::endl
+        << "weightsPacking=" << state.weightsPacking << std::endl;
+    ofs.close();
+    if (ofs.fail()) {
+      std::cerr << "Checkpoint: could not write " << statePath << ", skipping this checkpoint" << std::endl;
+      DiscardWeights(weightsPath, state.weightsFile);
+      return;
+    }
+  }
+  std::filesystem::rename(statePath + ".tmp", statePath, ec);
+  if (ec) {
+    std::cerr << "Checkpoint: could not rename " << statePath << ".tmp: " << ec.message()
+              << ", skipping this checkpoint" << std::endl;
+    DiscardWeights(weightsPath, state.weightsFile);
+    return;
+  }
+
+  // the previous weights are no longer referenced by state.txt
+  if (!lastWeightsFile.empty() && lastWeightsFile != state.weightsFile) {
+    std::filesystem::remove(CheckpointPath(dir, lastWeightsFile), ec);
+    if (ec) {
+      std::cerr << "Checkpoint: could not remove " << lastWeightsFile << ": " << ec.message() << std::endl;
+    }
+  }
+  lastWeightsFile = state.weightsFile;
+  std::cout << "\t Checkpoint for epoch " << state.nextEpoch << " written to " << dir << std::endl;
+}
@@ -0,0 +1,105 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#ifndef DPRIVE_ML__CHECKPOINT_H_
+#define DPRIVE_ML__CHECKPOINT_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "openfhe.h"
+#include "lr_types.h"
+
+////////// Checkpointing of the encrypted NAG training state ///////////////////////////////
+
+// packing of the weights written by this version (theta and (1 + eta) phi, see PackedNagStep).
+// Checkpoints from before it lack the field and read as "theta/phi"
+const char *const NAG_WEIGHTS_PACKING = "theta/scaled-phi";
+
+/* Everything besides the packed weights ciphertext that is needed to continue a run:
+ * the next epoch to run, the accumulated training time, how far each output file had been
+ * written and the mini-batch schedule position.
+ */
+struct CheckpointState {
+  usint nextEpoch = 0;
+  double totalTime = 0;
+  std::streamoff lossOffset = 0;
+  std::streamoff weightsOffset = 0;
+  std::streamoff testLossOffset = 0;
+  std::string batchScheduleState;
+  std::string weightsPacking = "theta/phi";  // what the odd blocks of the weights hold, see NAG_WEIGHTS_PACKING
+  std::string weightsFile;  // set by the writer
+};
+
+// reads <dir>/state.txt. Returns false if there is no checkpoint in dir
+bool ReadCheckpointState(const std::string &dir, CheckpointState &state);
+
+// deserializes the packed theta/phi ciphertext of the checkpoint and checks it was encrypted under keys
+CT LoadCheckpointWeights(const std::string &dir, const CheckpointState &state, const KeyPair &keys);
+
+/* Writes checkpoints on a background thread so the training loop only pays for handing over the
+ * state. At most one checkpoint is in flight and one is pending: submitting while the pending slot
+ * is full replaces it with the newer one. Files are written under temporary names and renamed, and
+ * state.txt is replaced last, so a crash mid-write leaves the previous checkpoint usable.
+ */
+class CheckpointWriter {
+ public:
+  // resumedWeightsFile is the weights file of the checkpoint the run resumed from, it is removed
+  //    once the first new checkpoint is written
+  explicit CheckpointWriter(const std::string &dir, const std::string &resumedWeightsFile = "");
+  ~CheckpointWriter();
+
+  // ctWeights must not be modified afterwards, pass a Clone() of a ciphertext that is updated in place
+  void Submit(const CT &ctWeights, const CheckpointState &state);
+
+  // blocks until every submitted checkpoint is on disk
+  void Wait();
+
+ private:
+  void Run();
+  void Write(const CT &ctWeights, CheckpointState state);
+  // removes the weights of a checkpoint that could not be completed
+  void DiscardWeights(const std::string &path, const std::string &name) const;
+
+  std::string dir;
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool hasPending = false;
+  bool writing = false;
+  bool stop = false;
+  CT pendingWeights;
+  CheckpointState pendingState;
+  std::string lastWeightsFile;
+  std::thread worker;
+};
+
+#endif //DPRIVE_ML__CHECKPOINT_H_
@@ -0,0 +1,60 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#include <iostream>
+#include <string>
+#include "data_io.h"
+
+// Converts CSV training data files into the binary data format of data_io.h, which LoadDataFile
+//    memory-maps without parsing. Each input.csv is written next to it as input.bin
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <file.csv> [<file.csv> ...]" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  for (int i = 1; i < argc; i++) {
+    std::string inFile = argv[i];
+    if (IsBinaryDataFile(inFile)) {
+      std::cout << inFile << " is already a binary data file, skipping" << std::endl;
+      continue;
+    }
+    auto extPos = inFile.rfind(".csv");
+    std::string outFile = (extPos == std::string::npos) ? inFile + ".bin" : inFile.substr(0, extPos) + ".bin";
+
+    Mat data;
+    std::vector<std::string> featureNames;
+    LoadDataFile(inFile, data, featureNames, -1, false);
+    WriteBinaryDataFile(outFile, data, featureNames);
+    std::cout << "Wrote " << data.NumRows() << " rows of " << featureNames.size() << " columns to " << outFile << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,299 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#include "crypto_planner.h"
+#include <cmath>
+#include <iomanip>
+#include <set>
+#include "utils.h"
+
+usint MaxLogQP128(uint32_t ringDim) {
+  // HomomorphicEncryption.org standard, classical 128-bit security, ternary secrets
+  switch (ringDim) {
+    case 1 << 10: return 27;
+    case 1 << 11: return 54;
+    case 1 << 12: return 109;
+    case 1 << 13: return 218;
+    case 1 << 14: return 438;
+    case 1 << 15: return 881;
+    case 1 << 16: return 1772;
+    case 1 << 17: return 3544;
+    default: return 0;
+  }
+}
+
+usint DefaultNumLargeDigits(usint multDepth) {
+  if (multDepth > 3) {
+    return 3;
+  }
+  return (multDepth > 0) ? 2 : 1;
+}
+
+usint EstimateAuxPrimes(usint multDepth, uint32_t firstModSize, uint32_t scalingModSize, usint numLargeDigits) {
+  usint numPrimes = multDepth + 1;
+  usint digits = (numLargeDigits == 0) ? DefaultNumLargeDigits(multDepth) : numLargeDigits;
+  usint primesPerDigit = (numPrimes + digits - 1) / digits;
+  // P has to exceed the largest digit, the one holding the first modulus
+  usint digitBits = firstModSize + (primesPerDigit - 1) * scalingModSize;
+  return (digitBits + PLAN_AUX_MOD_SIZE - 1) / PLAN_AUX_MOD_SIZE;
+}
+
+usint EstimateLogQP(usint multDepth, uint32_t firstModSize, uint32_t scalingModSize, usint numLargeDigits) {
+  usint auxPrimes = EstimateAuxPrimes(multDepth, firstModSize, scalingModSize, numLargeDigits);
+  return firstModSize + multDepth * scalingModSize + auxPrimes * PLAN_AUX_MOD_SIZE;
+}
+
+RotationKeyPlan PlanRotationKeys(usint rowSize, usint numSlots, MatVecLayout layout, usint hoistRadix) {
+  RotationKeyPlan keys;
+  // PackedNagStep and ThetaFromPackedWeights only rotate the packed weights by +rowSize
+  std::set<int32_t> rotations = {static_cast<int32_t>(rowSize)};
+  std::set<int32_t> fixedRotations = {static_cast<int32_t>(rowSize), -static_cast<int32_t>(rowSize)};
+  if (layout == MatVecLayout::DIAGONAL) {
+    // baby and giant steps plus the closing block sum, which always hoists
+    for (auto idx : DiagonalMatVecIndices(rowSize, numSlots, std::max(hoistRadix, usint(2)))) {
+      rotations.insert(idx);
+      fixedRotations.insert(idx);
+    }
+  } else if (hoistRadix > 0) {
+    for (auto idx : HoistedMatrixVectorIndices(rowSize, numSlots, hoistRadix)) {
+      rotations.insert(idx);
+    }
+  } else {
+    // EvalSumCols and EvalSumRows look up OpenFHE's own key sets
+    keys.evalSumKeys = true;
+  }
+  if (hoistRadix > 0) {
+    for (auto idx : HoistedMatrixVectorIndices(rowSize, numSlots, hoistRadix)) {
+      fixedRotations.insert(idx);
+    }
+  }
+  keys.rotations.assign(rotations.begin(), rotations.end());
+
+  // EvalSumKeyGen adds one key per power of two below numSlots to the same map as the rotations,
+  //    EvalSumRowsKeyGen one per power of two multiple of rowSize and EvalSumColsKeyGen one per
+  //    right rotation by a power of two, each in a map of its own
+  usint logSlots = 0;
+  while ((1U << logSlots) < numSlots) {
+    logSlots++;
+  }
+  usint logRowSize = 0;
+  while ((1U << logRowSize) < rowSize) {
+    logRowSize++;
+  }
+  auto withEvalSum = [&](std::set<int32_t> indices) {
+    for (usint i = 0; i < logSlots; i++) {
+      indices.insert(static_cast<int32_t>(1U << i));
+    }
+    return usint(indices.size()) + (logSlots - logRowSize) + logSlots;
+  };
+  keys.numKeys = keys.evalSumKeys ? withEvalSum(rotations) : usint(rotations.size());
+  keys.fixedNumKeys = withEvalSum(fixedRotations);
+  return keys;
+}
+
+std::vector<uint32_t> PlanLevelBudget(usint numSlotsBoot) {
+  usint logSlots = 0;
+  while ((1U << logSlots) < numSlotsBoot) {
+    logSlots++;
+  }
+  uint32_t budget = std::min(std::max((logSlots + 3) / 4, 1U), 4U);
+  return {budget, budget};
+}
+
+namespace {
+
+// fills in everything that depends on the ring dimension, returns false if it is not secure
+bool PlanForRing(const Parameters &params, uint32_t ringDim, CryptoPlan &plan) {
+  usint numSlots = ringDim / 2;
+  // theta and phi blocks of the packed weights, and the sparse bootstrapping slots
+  if (2 * plan.rowSize > numSlots || (plan.withBT && plan.numSlotsBoot > numSlots)) {
+    return false;
+  }
+  plan.ringDim = ringDim;
+  plan.layout = ResolveMatVecLayout(params, plan.numSamples, plan.numFeatures, numSlots);
+  plan.iteration.forward = (plan.layout == MatVecLayout::DIAGONAL) ? 1 : 2;
+
+  if (plan.withBT) {
+    usint iterationLevels = plan.itersPerBootstrap * plan.iteration.Total() + PLAN_BOOTSTRAP_HEADROOM;
+    plan.levelsBeforeBootstrap = iterationLevels;
+#if NATIVEINT == 64
+    // Add an extra level based on empirical run results. We've encountered an error of
+    //"DCRTPolyImpl's towers are not initialized" and this addition solves that.
+    plan.levelsBeforeBootstrap++;
+    // iterative (double) bootstrapping takes one more level
+    if (params.btPrecision > 0) {
+      plan.levelsBeforeBootstrap++;
+    }
+#endif
+    plan.levelBudget = PlanLevelBudget(plan.numSlotsBoot);
+    plan.bootstrapDepth = lbcrypto::FHECKKSRNS::GetBootstrapDepth(
+        PLAN_APPROX_BOOTSTRAP_DEPTH, plan.levelBudget, lbcrypto::UNIFORM_TERNARY);
+    plan.multDepth = plan.levelsBeforeBootstrap + plan.bootstrapDepth;
+    plan.weightsLevel = plan.multDepth - plan.levelsBeforeBootstrap;
+    // the extra 64-bit levels stay unused
+    plan.maxWeightsLevel = plan.weightsLevel + iterationLevels;
+  } else {
+    // the weights are re-encrypted at level 0 every itersPerBootstrap iterations
+    plan.multDepth = plan.itersPerBootstrap * plan.iteration.Total() + plan.iteration.firstIteration;
+    plan.weightsLevel = 0;
+    plan.maxWeightsLevel = plan.multDepth;
+  }
+  plan.datasetLevels = PlanDatasetLevels(plan.weightsLevel, plan.datasetChebDegree, plan.layout);
+
+  plan.logQP = EstimateLogQP(plan.multDepth, plan.firstModSize, plan.scalingModSize, plan.numLargeDigits);
+  plan.maxLogQP = MaxLogQP128(ringDim);
+  if (plan.logQP > plan.maxLogQP) {
+    return false;
+  }
+
+  // dataset: each ciphertext holds 2 * (multDepth + 1 - level) towers of ringDim 64-bit words
+  plan.matVecCost = EstimateMatVecCost(plan.layout, plan.numSamples, plan.rowSize, numSlots, params.hoistRadix);
+  usint shards = plan.matVecCost.shards;
+  usint perShard = (plan.layout == MatVecLayout::DIAGONAL) ? plan.rowSize : 1;
+  auto towersMB = [&](usint level) {
+    return 2.0 * ringDim * (plan.multDepth + 1 - level) * sizeof(uint64_t) * (NATIVEINT / 64) / (1 << 20);
+  };
+  usint xLevel = params.singleX ? std::min(plan.datasetLevels.x, plan.datasetLevels.negXt) : plan.datasetLevels.x;
+  plan.datasetMB = shards * (perShard * towersMB(xLevel) + towersMB(plan.datasetLevels.labels));
+  if (!params.singleX) {
+    plan.datasetMB += shards * perShard * towersMB(plan.datasetLevels.negXt);
+  }
+  // the products plus the rotation of the packed weights
+  plan.keySwitchesPerIteration = plan.matVecCost.keySwitches + 1;
+
+  // a HYBRID key switching key holds a pair of polynomials over Q*P for every digit
+  plan.rotationKeys = PlanRotationKeys(plan.rowSize, numSlots, plan.layout, params.hoistRadix);
+  usint digits = (plan.numLargeDigits == 0) ? DefaultNumLargeDigits(plan.multDepth) : plan.numLargeDigits;
+  usint towersQP = plan.multDepth + 1 +
+      EstimateAuxPrimes(plan.multDepth, plan.firstModSize, plan.scalingModSize, plan.numLargeDigits);
+  plan.rotationKeyMB = 2.0 * digits * towersQP * ringDim * sizeof(uint64_t) * (NATIVEINT / 64) / (1 << 20);
+  return true;
+}
+
+} // namespace
+
+CryptoPlan PlanCryptoParams(const Parameters &params, usint numSamples, usint numFeatures, usint chebDegree,
+                            uint32_t ringDim, usint datasetChebDegree) {
+  CryptoPlan plan;
+  plan.numSamples = numSamples;
+  plan.numFeatures = numFeatures;
+  plan.rowSize = NextPow2(numFeatures);
+  plan.chebDegree = chebDegree;
+  plan.datasetChebDegree = (datasetChebDegree == 0) ? chebDegree : datasetChebDegree;
+  plan.iteration.sigmoid = ChebyshevDepth(chebDegree);
+  plan.withBT = params.withBT;
+  plan.itersPerBootstrap = params.itersPerBootstrap;
+  plan.numSlotsBoot = plan.rowSize * 8;
+
+  if (ringDim != 0) {
+    plan.ringDimForced = true;
+    if (!PlanForRing(params, ringDim, plan)) {
+      std::cerr << "Ring dimension " << ringDim << " is too small for this job: log2(QP) ~ " << plan.logQP
+                << " allows at most " << MaxLogQP128(ringDim) << " bits, and "
+                << std::max(2 * plan.rowSize, plan.withBT ? plan.numSlotsBoot : 0) << " slots are needed"
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    return plan;
+  }
+  for (uint32_t candidate = 1 << 10; candidate <= (1 << 17); candidate *= 2) {
+    if (PlanForRing(params, candidate, plan)) {
+      return plan;
+    }
+  }
+  std::cerr << "No ring dimension up to 2^17 is secure for a multiplicative depth of " << plan.multDepth
+            << " (log2(QP) ~ " << plan.logQP << ")" << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+void PrintCryptoPlan(const CryptoPlan &plan) {
+  auto &it = plan.iteration;
+  std::cout << "*********************************************" << std::endl;
+  std::cout << "Crypto plan for " << plan.numSamples << " x " << plan.numFeatures << " (rowSize " << plan.rowSize
+            << "), " << MatVecLayoutName(plan.layout) << " layout" << std::endl;
+  std::cout << "\tIteration depth: theta " << it.theta << " + forward " << it.forward << " + sigmoid "
+            << it.sigmoid << " (degree " << plan.chebDegree << ") + gradient " << it.backward << " = "
+            << it.Total() << " (+" << it.firstIteration << " in the first iteration)" << std::endl;
+  if (plan.withBT) {
+    std::cout << "\tBootstrapping: " << plan.numSlotsBoot << " slots, level budget {" << plan.levelBudget[0]
+              << ", " << plan.levelBudget[1] << "}, depth " << plan.bootstrapDepth << ", "
+              << plan.levelsBeforeBootstrap << " levels before bootstrapping" << std::endl;
+  }
+  std::cout << "\tRefreshes: " << (plan.withBT ? "bootstrapping" : "re-encryption") << " when an iteration would "
+            << "leave the weights past level " << plan.maxWeightsLevel << ", sized for " << plan.itersPerBootstrap
+            << " iteration(s)" << std::endl;
+  std::cout << "\tMultiplicative depth: " << plan.multDepth << ", weights at level " << plan.weightsLevel
+            << std::endl;
+  if (plan.datasetChebDegree != plan.chebDegree) {
+    std::cout << "\tDataset levels planned for the degree " << plan.datasetChebDegree << " sigmoid" << std::endl;
+  }
+  std::cout << "\tModuli: first " << plan.firstModSize << " bits, scaling " << plan.scalingModSize
+            << " bits, log2(QP) ~ " << plan.logQP << " of " << plan.maxLogQP << " allowed" << std::endl;
+  std::cout << "\tRing dimension: " << plan.ringDim << " (" << plan.ringDim / 2 << " slots"
+            << (plan.ringDimForced ? ", given" : ", smallest secure") << ")" << std::endl;
+  std::cout << "\tDataset: " << plan.matVecCost.shards << " shard(s), " << plan.matVecCost.ciphertexts
+            << " ciphertexts, ~" << std::fixed << std::setprecision(1) << plan.datasetMB << " MB" << std::endl;
+  auto &keys = plan.rotationKeys;
+  std::cout << "\tRotation keys: " << keys.numKeys << (keys.evalSumKeys ? " (EvalSumRows/EvalSumCols sets)" : "")
+            << ", ~" << keys.numKeys * plan.rotationKeyMB << " MB; every set of the fixed key generation would be "
+            << keys.fixedNumKeys << ", ~" << keys.fixedNumKeys * plan.rotationKeyMB << " MB" << std::endl;
+  std::cout << "\tPer iteration: ~" << plan.keySwitchesPerIteration << " key switches and 1/"
+            << plan.itersPerBootstrap << (plan.withBT ? " bootstrap" : " re-encryption") << std::defaultfloat
+            << std::setprecision(6) << std::endl;
+  std::cout << "*********************************************" << std::endl;
+}
+
+void ApplyCryptoPlan(const CryptoPlan &plan, CryptoParams &parameters) {
+  parameters.SetMultiplicativeDepth(plan.multDepth);
+  parameters.SetScalingModSize(plan.scalingModSize);
+  parameters.SetFirstModSize(plan.firstModSize);
+  parameters.SetNumLargeDigits(plan.numLargeDigits);
+  parameters.SetRingDim(plan.ringDim);
+  parameters.SetBatchSize(plan.ringDim / 2);
+  if (plan.withBT) {
+    parameters.SetSecretKeyDist(lbcrypto::UNIFORM_TERNARY);
+  }
+}
+
+void PrintRotationKeyReport(const CryptoPlan &plan, double keyGenMs, usint numBootstrapKeys) {
+  auto &keys = plan.rotationKeys;
+  double msPerKey = (keys.numKeys > 0) ? keyGenMs / keys.numKeys : 0;
+  usint saved = keys.fixedNumKeys - keys.numKeys;
+  std::cout << "\t" << keys.numKeys << " rotation keys in " << keyGenMs / 1000.0 << " s";
+  if (plan.withBT) {
+    std::cout << ", plus " << numBootstrapKeys << " bootstrapping keys";
+  }
+  std::cout << std::endl;
+  std::cout << "\tSaved " << saved << " of the " << keys.fixedNumKeys << " keys the fixed key generation made: ~"
+            << std::fixed << std::setprecision(1) << saved * plan.rotationKeyMB << " MB and ~"
+            << saved * msPerKey / 1000.0 << " s of key generation" << std::defaultfloat << std::setprecision(6)
+            << std::endl;
+}
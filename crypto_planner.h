@@ -0,0 +1,171 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#ifndef DPRIVE_ML__CRYPTO_PLANNER_H_
+#define DPRIVE_ML__CRYPTO_PLANNER_H_
+
+#include <vector>
+#include "openfhe.h"
+#include "lr_types.h"
+#include "depth_schedule.h"
+#include "enc_matrix.h"
+#include "parameters.h"
+
+////////// Choosing the CKKS parameters from the shape of the job ///////////////////////////////
+
+/* The planner derives every crypto parameter lr_nag used to hard-code from what the run needs:
+ *    1) the depth of one iteration, from the matrix-vector layout and the Chebyshev degree
+ *    2) the multiplicative depth: that depth times the iterations per refresh (+1 for the first
+ *       iteration) interactively, or the levels before bootstrapping, sized the same way, plus the
+ *       bootstrapping depth of a level budget sized for the sparse bootstrapping slots
+ *    3) the size of Q*P this gives with the native modulus sizes and OpenFHE's digit count
+ *    4) the smallest ring dimension the HE standard allows for that modulus at 128-bit classic
+ *       security that also holds the packed weights and the bootstrapping slots
+ * so a small job gets a small ring instead of a fixed 2^17.
+ */
+
+// modulus sizes of the native integer width: the scaling primes are as large as the word allows
+#if NATIVEINT == 128
+const uint32_t PLAN_FIRST_MOD_SIZE = 89;
+const uint32_t PLAN_SCALING_MOD_SIZE = 78;
+#else
+const uint32_t PLAN_FIRST_MOD_SIZE = 60;
+const uint32_t PLAN_SCALING_MOD_SIZE = 59;
+#endif
+// auxiliary (P) primes OpenFHE uses for HYBRID key switching
+const uint32_t PLAN_AUX_MOD_SIZE = 60;
+const uint32_t PLAN_APPROX_BOOTSTRAP_DEPTH = 8;
+// levels before bootstrapping beyond the iterations, taken by the first iteration
+const uint32_t PLAN_BOOTSTRAP_HEADROOM = 1;
+
+// Levels one training iteration consumes, see depth_schedule.h
+struct IterationDepth {
+  usint theta = 1;           // ThetaFromPackedWeights
+  usint forward = 2;         // MatrixVectorProductRow (1 with the diagonal layout)
+  usint sigmoid = 0;         // ChebyshevDepth(degree)
+  usint backward = 1;        // MatrixVectorProductCol
+  usint firstIteration = 1;  // PackedNagStep scales the first gradient
+
+  usint Total() const { return theta + forward + sigmoid + backward; }
+};
+
+/* Rotation keys a run needs, collected from the rotations it actually performs instead of
+ * generating the EvalSum, EvalSumRows and EvalSumCols key sets for every run:
+ *    - +rowSize for ThetaFromPackedWeights and PackedNagStep
+ *    - HoistedMatrixVectorIndices with -H > 0, DiagonalMatVecIndices with the diagonal layout
+ *    - the three EvalSum sets only for EvalSumCols/EvalSumRows (-H 0 with the row-major layout)
+ * The bootstrapping keys are EvalBootstrapKeyGen's own and not counted.
+ */
+struct RotationKeyPlan {
+  std::vector<int32_t> rotations;  // for EvalRotateKeyGen
+  bool evalSumKeys = false;        // EvalSumKeyGen, EvalSumRowsKeyGen and EvalSumColsKeyGen
+  usint numKeys = 0;               // keys generated, OpenFHE's EvalSum sets included
+  usint fixedNumKeys = 0;          // keys the fixed EvalSum sets + +-rowSize + matrix-vector indices made
+};
+
+struct CryptoPlan {
+  // job shape
+  usint numSamples = 0;
+  usint numFeatures = 0;
+  usint rowSize = 0;
+  MatVecLayout layout = MatVecLayout::ROW_MAJOR;
+  usint chebDegree = 0;
+  usint datasetChebDegree = 0;      // the shallowest sigmoid the dataset levels are planned for
+
+  // depth
+  IterationDepth iteration;
+  bool withBT = false;
+  usint multDepth = 0;
+  usint weightsLevel = 0;           // level of the weights at the start of an iteration
+  usint levelsBeforeBootstrap = 0;  // 0 without bootstrapping
+  usint itersPerBootstrap = 1;      // iterations the levels between refreshes are sized for
+  usint maxWeightsLevel = 0;        // deepest level an iteration may leave the weights at (BootstrapScheduler)
+  usint bootstrapDepth = 0;
+  std::vector<uint32_t> levelBudget;
+  usint numSlotsBoot = 0;
+  DatasetLevels datasetLevels;
+
+  // modulus and ring
+  uint32_t firstModSize = PLAN_FIRST_MOD_SIZE;
+  uint32_t scalingModSize = PLAN_SCALING_MOD_SIZE;
+  usint numLargeDigits = 0;
+  usint logQP = 0;
+  usint maxLogQP = 0;               // allowed for ringDim
+  uint32_t ringDim = 0;
+  bool ringDimForced = false;       // given with -d or by a dataset bundle
+
+  // predicted cost
+  MatVecCost matVecCost;
+  double datasetMB = 0;
+  double keySwitchesPerIteration = 0;
+
+  // keys
+  RotationKeyPlan rotationKeys;
+  double rotationKeyMB = 0;         // size of one rotation key
+};
+
+// largest log2(Q*P) the HE standard allows at 128-bit classic security with ternary secrets, 0 above 2^17
+usint MaxLogQP128(uint32_t ringDim);
+
+// the number of key switching digits OpenFHE picks when numLargeDigits is 0
+usint DefaultNumLargeDigits(usint multDepth);
+
+// number of auxiliary (P) primes HYBRID key switching needs with numLargeDigits digits
+usint EstimateAuxPrimes(usint multDepth, uint32_t firstModSize, uint32_t scalingModSize, usint numLargeDigits);
+
+// upper bound on log2(Q*P) for HYBRID key switching with numLargeDigits digits
+usint EstimateLogQP(usint multDepth, uint32_t firstModSize, uint32_t scalingModSize, usint numLargeDigits);
+
+// {CoeffsToSlots, SlotsToCoeffs} levels: one level per factor of up to 16 in the slot count
+std::vector<uint32_t> PlanLevelBudget(usint numSlotsBoot);
+
+/* Plans the parameters of a run over numSamples x numFeatures with a Chebyshev sigmoid of chebDegree.
+ * ringDim 0 picks the smallest secure one, otherwise it is checked. Exits with a message when no
+ * ring dimension up to 2^17 works or ringDim is too small. When some iterations run a lower degree
+ * (see SigmoidSchedule), datasetChebDegree is the lowest one: -X' and the labels are encrypted for
+ * it, since a deeper operand would drag the shallower iterations down. 0 is chebDegree.
+ */
+CryptoPlan PlanCryptoParams(const Parameters &params, usint numSamples, usint numFeatures, usint chebDegree,
+                            uint32_t ringDim = 0, usint datasetChebDegree = 0);
+
+// prints the plan and its predicted cost breakdown
+void PrintCryptoPlan(const CryptoPlan &plan);
+
+// the rotation keys of a run over rowSize-wide rows in numSlots slots, see RotationKeyPlan
+RotationKeyPlan PlanRotationKeys(usint rowSize, usint numSlots, MatVecLayout layout, usint hoistRadix);
+
+// prints how long the planned rotation keys took to generate and what skipping the fixed sets saved
+void PrintRotationKeyReport(const CryptoPlan &plan, double keyGenMs, usint numBootstrapKeys);
+
+// sets the planned depth, moduli, ring and batch size on parameters
+void ApplyCryptoPlan(const CryptoPlan &plan, CryptoParams &parameters);
+
+#endif //DPRIVE_ML__CRYPTO_PLANNER_H_
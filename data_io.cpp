@@ -31,6 +31,320 @@
 
 #include "limits"
 #include "data_io.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <omp.h>
+
+namespace {
+
+// chunks smaller than this are not worth a thread of their own
+const size_t MIN_CHUNK_BYTES = 1 << 20;
+
+// read-only mapping of a whole file, unmapped on destruction
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string &filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) == 0) {
+      size = st.st_size;
+      if (size == 0) {
+        opened = true;
+      } else {
+        void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+          madvise(addr, size, MADV_SEQUENTIAL);
+          data = static_cast<const char *>(addr);
+          opened = true;
+        }
+      }
+    }
+    close(fd);
+  }
+  ~MappedFile() {
+    if (data) {
+      munmap(const_cast<char *>(data), size);
+    }
+  }
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool IsOpen() const { return opened; }
+  const char *Begin() const { return data; }
+  const char *End() const { return data + size; }
+
+ private:
+  const char *data = nullptr;
+  size_t size = 0;
+  bool opened = false;
+};
+
+// start of the line following p, or end
+const char *NextLine(const char *p, const char *end) {
+  if (p >= end) {
+    return end;
+  }
+  auto nl = static_cast<const char *>(memchr(p, '\n', end - p));
+  return nl ? nl + 1 : end;
+}
+
+// end of the line content starting at p, without the line terminator
+const char *LineEnd(const char *p, const char *next) {
+  if (next > p && next[-1] == '\n') {
+    --next;
+  }
+  if (next > p && next[-1] == '\r') {
+    --next;
+  }
+  return next;
+}
+
+bool IsBlank(const char *p, const char *lineEnd) {
+  return std::all_of(p, lineEnd, [](char c) { return c == ' ' || c == '\t'; });
+}
+
+// end of the first maxLines non-blank lines in [p, end)
+const char *SkipRecords(const char *p, const char *end, size_t maxLines) {
+  while (p < end && maxLines > 0) {
+    auto next = NextLine(p, end);
+    if (!IsBlank(p, LineEnd(p, next))) {
+      maxLines--;
+    }
+    p = next;
+  }
+  return p;
+}
+
+// parses one record, appending its fields to values. Returns the number of fields or 0 if malformed
+size_t ParseRecord(const char *p, const char *lineEnd, Vec &values) {
+  size_t numFields = 0;
+  while (true) {
+    while (p < lineEnd && (*p == ' ' || *p == '\t')) {
+      p++;
+    }
+    // from_chars does not accept a leading '+'
+    if (p < lineEnd && *p == '+') {
+      p++;
+    }
+    prim_type val;
+    auto [ptr, ec] = std::from_chars(p, lineEnd, val);
+    if (ec != std::errc()) {
+      return 0;
+    }
+    values.push_back(val);
+    numFields++;
+    p = ptr;
+    while (p < lineEnd && (*p == ' ' || *p == '\t')) {
+      p++;
+    }
+    if (p == lineEnd) {
+      return numFields;
+    }
+    if (*p != ',') {
+      return 0;
+    }
+    p++;
+  }
+}
+
+struct CsvChunk {
+  const char *begin = nullptr;
+  const char *end = nullptr;
+  Vec values;
+  size_t numRows = 0;
+  size_t numCols = 0;
+  const char *badRecord = nullptr;  // first malformed record, if any
+};
+
+void ParseChunk(CsvChunk &chunk) {
+  // rough guess of ~8 characters per field
+  chunk.values.reserve((chunk.end - chunk.begin) / 8);
+  for (auto p = chunk.begin; p < chunk.end;) {
+    auto next = NextLine(p, chunk.end);
+    auto lineEnd = LineEnd(p, next);
+    if (!IsBlank(p, lineEnd)) {
+      auto numFields = ParseRecord(p, lineEnd, chunk.values);
+      if (numFields == 0 || (chunk.numRows > 0 && numFields != chunk.numCols)) {
+        chunk.badRecord = p;
+        return;
+      }
+      chunk.numCols = numFields;
+      chunk.numRows++;
+    }
+    p = next;
+  }
+}
+
+[[noreturn]] void MalformedRecord(const char *begin, const char *record) {
+  auto lineNum = std::count(begin, record, '\n') + 1;
+  std::cerr << "Malformed or inconsistent CSV record on data line " << lineNum << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+void ParseHeader(const std::string &line, std::vector<std::string> &featureNames) {
+  std::string tok;
+  std::stringstream ss(line);
+  while (getline(ss, tok, ',')) {
+    featureNames.push_back(tok);
+  }
+}
+
+const char BINARY_MAGIC[8] = {'L', 'R', 'D', 'A', 'T', 'A', '0', '1'};
+
+bool IsLittleEndian() {
+  const uint16_t probe = 1;
+  return *reinterpret_cast<const uint8_t *>(&probe) == 1;
+}
+
+// bounds-checked reader over the mapped header of a binary data file
+class BinaryReader {
+ public:
+  BinaryReader(const char *begin, const char *end, const std::string &filename)
+      : begin(begin), pos(begin), end(end), filename(filename) {}
+
+  void Read(void *dst, size_t numBytes) {
+    if (size_t(end - pos) < numBytes) {
+      std::cerr << "Truncated binary data file " << filename << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    memcpy(dst, pos, numBytes);
+    pos += numBytes;
+  }
+  template<typename T>
+  T Read() {
+    T val;
+    Read(&val, sizeof(T));
+    return val;
+  }
+  void AlignTo(size_t alignment) {
+    size_t offset = pos - begin;
+    pos = begin + std::min<size_t>((offset + alignment - 1) / alignment * alignment, end - begin);
+  }
+  const char *Pos() const { return pos; }
+
+ private:
+  const char *begin;
+  const char *pos;
+  const char *end;
+  const std::string &filename;
+};
+
+/* Reads a binary data file from its mapping. The header statistics are returned through stats
+ * only when every row is read, since they describe the whole file.
+ */
+bool ReadBinaryData(const MappedFile &file, const std::string &filename, Mat &data,
+                    std::vector<std::string> &featureNames, int numRowsToRead, ColumnStats &stats) {
+  if (!IsLittleEndian()) {
+    std::cerr << "Binary data files are little-endian, convert " << filename << " on this host instead" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  BinaryReader reader(file.Begin(), file.End(), filename);
+  char magic[sizeof(BINARY_MAGIC)];
+  reader.Read(magic, sizeof(magic));
+
+  auto numRows = reader.Read<uint64_t>();
+  auto numCols = reader.Read<uint64_t>();
+  for (uint64_t j = 0; j < numCols; j++) {
+    std::string name(reader.Read<uint32_t>(), '\0');
+    reader.Read(name.data(), name.size());
+    featureNames.push_back(name);
+  }
+  ColumnStats fileStats{Vec(numCols), Vec(numCols), Vec(numCols)};
+  reader.Read(fileStats.minVals.data(), numCols * sizeof(prim_type));
+  reader.Read(fileStats.maxVals.data(), numCols * sizeof(prim_type));
+  reader.Read(fileStats.means.data(), numCols * sizeof(prim_type));
+  reader.AlignTo(sizeof(prim_type));
+
+  uint64_t rowsToCopy = (numRowsToRead < 0) ? numRows : std::min<uint64_t>(numRows, numRowsToRead);
+  if (size_t(file.End() - reader.Pos()) < numRows * numCols * sizeof(prim_type)) {
+    std::cerr << "Truncated binary data file " << filename << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  auto values = reinterpret_cast<const prim_type *>(reader.Pos());
+  std::copy_n(values, rowsToCopy * numCols, data.AppendRows(rowsToCopy, numCols));
+  if (rowsToCopy == numRows) {
+    stats = std::move(fileStats);
+    return true;
+  }
+  return false;
+}
+
+} // namespace
+
+ColumnStats ComputeColumnStats(const Mat &data) {
+  size_t numCols = data.NumCols();
+  ColumnStats stats{Vec(numCols, 1e10), Vec(numCols, -1e10), Vec(numCols, 0.0)};
+  for (size_t i = 0; i < data.NumRows(); i++) {
+    auto row = data[i];
+    for (size_t j = 0; j < numCols; j++) {
+      stats.means[j] += row[j];
+      stats.maxVals[j] = std::max(stats.maxVals[j], row[j]);
+      stats.minVals[j] = std::min(stats.minVals[j], row[j]);
+    }
+  }
+  for (size_t j = 0; j < numCols; j++) {
+    stats.means[j] /= double(data.NumRows());
+  }
+  return stats;
+}
+
+bool IsBinaryDataFile(const std::string &filename) {
+  std::ifstream ifs(filename, std::ios::binary);
+  char magic[sizeof(BINARY_MAGIC)];
+  return ifs.read(magic, sizeof(magic)) && memcmp(magic, BINARY_MAGIC, sizeof(magic)) == 0;
+}
+
+void WriteBinaryDataFile(const std::string &filename, const Mat &data, const std::vector<std::string> &featureNames) {
+  if (!IsLittleEndian()) {
+    std::cerr << "Binary data files are little-endian, cannot write them on this host" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  uint64_t numRows = data.NumRows();
+  uint64_t numCols = data.Empty() ? featureNames.size() : data.NumCols();
+  if (featureNames.size() != numCols) {
+    std::cerr << "Got " << featureNames.size() << " feature names for " << numCols << " columns" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  std::ofstream ofs(filename, std::ios::binary | std::ios::trunc);
+  if (!ofs.is_open()) {
+    std::cerr << "Could not open file to write binary data to " << filename << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  auto write = [&ofs](const void *src, size_t numBytes) {
+    ofs.write(static_cast<const char *>(src), numBytes);
+  };
+  write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+  write(&numRows, sizeof(numRows));
+  write(&numCols, sizeof(numCols));
+  for (auto &name : featureNames) {
+    uint32_t len = name.size();
+    write(&len, sizeof(len));
+    write(name.data(), len);
+  }
+  auto stats = ComputeColumnStats(data);
+  write(stats.minVals.data(), numCols * sizeof(prim_type));
+  write(stats.maxVals.data(), numCols * sizeof(prim_type));
+  write(stats.means.data(), numCols * sizeof(prim_type));
+  const char padding[sizeof(prim_type)] = {};
+  write(padding, (sizeof(prim_type) - ofs.tellp() % sizeof(prim_type)) % sizeof(prim_type));
+  write(data.Data(), data.NumElements() * sizeof(prim_type));
+  if (!ofs) {
+    std::cerr << "Failed writing binary data to " << filename << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
 
 void ReadHeader(
     std::istream &is,
@@ -38,12 +352,63 @@ void ReadHeader(
 
   std::string line;
   getline(is, line);
-  Vec fields;
-  std::string tok;
-  std::stringstream ss(line);
-  while (getline(ss, tok, ',')) {
-    featureNames.push_back(tok);
+  ParseHeader(line, featureNames);
+}
+
+size_t ParseCsvRecords(
+    const char *begin,
+    const char *end,
+    Mat &data,
+    int maxLines) {
+
+  if (maxLines >= 0) {
+    end = SkipRecords(begin, end, maxLines);
+  }
+
+  // cut the buffer into roughly equal chunks, each starting on a line boundary
+  size_t numBytes = end - begin;
+  size_t numChunks = std::max<size_t>(1, std::min<size_t>(omp_get_max_threads(), numBytes / MIN_CHUNK_BYTES));
+  std::vector<CsvChunk> chunks(numChunks);
+  const char *chunkStart = begin;
+  for (size_t c = 0; c < numChunks; c++) {
+    chunks[c].begin = chunkStart;
+    chunkStart = (c + 1 == numChunks) ? end : NextLine(std::max(chunkStart, begin + numBytes * (c + 1) / numChunks), end);
+    chunks[c].end = chunkStart;
+  }
+
+#pragma omp parallel for
+  for (size_t c = 0; c < numChunks; c++) {
+    ParseChunk(chunks[c]);
+  }
+
+  // stitch the chunks together, checking every chunk agrees on the number of columns
+  size_t numRows = 0;
+  size_t numCols = data.NumCols();
+  std::vector<size_t> rowOffsets(numChunks);
+  for (size_t c = 0; c < numChunks; c++) {
+    if (chunks[c].badRecord) {
+      MalformedRecord(begin, chunks[c].badRecord);
+    }
+    if (chunks[c].numRows == 0) {
+      continue;
+    }
+    if (numCols != 0 && chunks[c].numCols != numCols) {
+      MalformedRecord(begin, chunks[c].begin);
+    }
+    numCols = chunks[c].numCols;
+    rowOffsets[c] = numRows;
+    numRows += chunks[c].numRows;
+  }
+
+  if (numRows == 0) {
+    return 0;
   }
+  auto out = data.AppendRows(numRows, numCols);
+#pragma omp parallel for
+  for (size_t c = 0; c < numChunks; c++) {
+    std::copy(chunks[c].values.begin(), chunks[c].values.end(), out + rowOffsets[c] * numCols);
+  }
+  return numRows;
 }
 
 void ReadData(
@@ -51,26 +416,13 @@ void ReadData(
     Mat &data,
     int maxLines) {
 
-  if (maxLines < 0)
-    maxLines = std::numeric_limits<int>::max();
-
   if (maxLines == 0) {
     std::cerr << "Please specify a non-zero number of rows to read." << std::endl;
     exit(0);
   }
 
-  std::string line;
-  while (getline(is, line) && (maxLines-- > 0)) {
-    //fields contains the intercept as well
-    Vec fields;
-    std::string tok;
-    std::stringstream ss(line);
-    while (getline(ss, tok, ',')) {
-      fields.push_back(stof(tok));
-    }
-    Vec dataRow(fields.begin(), fields.end());
-    data.push_back(dataRow);
-  }
+  std::string contents{std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>()};
+  ParseCsvRecords(contents.data(), contents.data() + contents.size(), data, maxLines);
 }
 
 void LoadDataFile(
@@ -80,42 +432,51 @@ void LoadDataFile(
     int numRowsToRead,
     bool normalize_flag) {
 
-  std::filebuf fb;
-  if (fb.open(filename, std::ios::in)) {
+  if (numRowsToRead == 0) {
+    std::cerr << "Please specify a non-zero number of rows to read." << std::endl;
+    exit(0);
+  }
+
+  ColumnStats stats;
+  bool haveStats = false;
+  {
+    MappedFile file(filename);
+    if (!file.IsOpen()) {
+      std::cerr << "Error reading in file " << filename << std::endl;
+      exit(EXIT_FAILURE);
+    }
 
-    std::istream is(&fb);
+    if (size_t(file.End() - file.Begin()) >= sizeof(BINARY_MAGIC) &&
+        memcmp(file.Begin(), BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0) {
+      // the header statistics only describe data if nothing was in it before
+      bool wasEmpty = data.Empty();
+      haveStats = ReadBinaryData(file, filename, data, featureNames, numRowsToRead, stats) && wasEmpty;
+    } else {
+      auto dataStart = NextLine(file.Begin(), file.End());
+      ParseHeader(std::string(file.Begin(), LineEnd(file.Begin(), dataStart)), featureNames);
 
-    ReadHeader(is, featureNames);
-    ReadData(is, data, numRowsToRead);
+      ParseCsvRecords(dataStart, file.End(), data, numRowsToRead);
+    }
+  }
 
-    fb.close();
-  } else {
-    std::cerr << "Error reading in file " << filename << std::endl;
+  if (data.Empty()) {
+    std::cerr << "No data rows in file " << filename << std::endl;
     exit(EXIT_FAILURE);
   }
 
-  int numCols = data[0].size();
-  int numRows = data.size();
-  Vec accume(numCols, 0.0);
-  Vec maxVals(numCols, -1e10);
-  Vec minVals(numCols, 1e10);
+  int numCols = data.NumCols();
+  int numRows = data.NumRows();
 
   // Summary stats for each col
-  for (auto i = 0; i < numRows; i++) {
-    for (auto j = 0; j < numCols; j++) {
-      auto val = data[i][j];
-      accume[j] += val;
-      maxVals[j] = std::max(maxVals[j], val);
-      minVals[j] = std::min(minVals[j], val);
-    }
-  }
-  for (auto j = 0; j < numCols; j++) {
-    accume[j] /= double(numRows);
+  if (!haveStats) {
+    stats = ComputeColumnStats(data);
   }
+  auto &minVals = stats.minVals;
+  auto &maxVals = stats.maxVals;
 
   std::cout << "Feature Analysis:    min     ave    max" << std::endl;
   for (auto j = 0; j < numCols; j++) {
-    std::cout << "\t" << featureNames[j] << ": " << minVals[j] << " " << accume[j] << " " << maxVals[j] << std::endl;
+    std::cout << "\t" << featureNames[j] << ": " << minVals[j] << " " << stats.means[j] << " " << maxVals[j] << std::endl;
   }
 
   if (normalize_flag) {
@@ -134,27 +495,13 @@ void LoadDataFile(
     }
 
     {
-      Vec normalizedAccumE(numCols, 0.0);
-      Vec normalizedMaxVals(numCols, -1e10);
-      Vec normalizedMinVals(numCols, 1e10);
-
-      for (auto i = 0; i < numRows; i++) {
-        for (auto j = 0; j < numCols; j++) {
-          auto val = data[i][j];
-          normalizedAccumE[j] += val;
-          normalizedMaxVals[j] = std::max(normalizedMaxVals[j], val);
-          normalizedMinVals[j] = std::min(normalizedMinVals[j], val);
-        }
-      }
-      for (auto j = 0; j < numCols; j++) {
-        normalizedAccumE[j] /= double(numRows);
-      }
+      auto normalized = ComputeColumnStats(data);
 
       std::cout << "Normalized:" << std::endl;
       std::cout << "feature:    min     ave    max" << std::endl;
       for (auto j = 0; j < numCols; j++) {
-        std::cout << featureNames[j] << ": " << normalizedMinVals[j] << " " << normalizedAccumE[j] << " "
-                  << normalizedMaxVals[j] << std::endl;
+        std::cout << featureNames[j] << ": " << normalized.minVals[j] << " " << normalized.means[j] << " "
+                  << normalized.maxVals[j] << std::endl;
       }
     }
 
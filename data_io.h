@@ -47,8 +47,37 @@ void ReadHeader(std::istream &is, std::vector<std::string> &featureNames);
  */
 void ReadData(std::istream &is, Mat &data, int maxLines = -1);
 
-/* Creates an input file stream and uses ReadData to read rowsToRead rows from the file.
- * If rowsToRead is negative, it will read all rows in the file.
+/* Parses up to maxLines comma-separated records of [begin, end) at full double precision and appends
+ * them as rows of data. Blank lines are skipped. The buffer is cut into chunks at line boundaries that
+ * are parsed in parallel. Returns the number of rows parsed.
+ * If maxLines is negative, every record in the buffer is parsed.
+ */
+size_t ParseCsvRecords(const char *begin, const char *end, Mat &data, int maxLines = -1);
+
+/* Per-column summary statistics, stored in the header of binary data files
+ */
+struct ColumnStats {
+  Vec minVals;
+  Vec maxVals;
+  Vec means;
+};
+
+ColumnStats ComputeColumnStats(const Mat &data);
+
+/* Binary data file layout, all integers and doubles little-endian:
+ *    magic "LRDATA01", uint64 numRows, uint64 numCols,
+ *    numCols feature names (uint32 length + bytes),
+ *    numCols doubles each of column min, max and mean,
+ *    zero padding to a multiple of 8 bytes, numRows * numCols row-major doubles.
+ */
+bool IsBinaryDataFile(const std::string &filename);
+
+// writes data in the binary format above, computing the column statistics
+void WriteBinaryDataFile(const std::string &filename, const Mat &data, const std::vector<std::string> &featureNames);
+
+/* Memory-maps the file and reads rowsToRead rows from it. Binary data files (see above) are copied
+ * straight out of the mapping and their column statistics are taken from the header; CSV files are
+ * parsed with ParseCsvRecords. If rowsToRead is negative, it will read all rows in the file.
  */
 void LoadDataFile(std::string filename, Mat &data, std::vector<std::string> &featureNames, int rowsToRead, bool normalize_flag);
 
@@ -0,0 +1,84 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#include "depth_schedule.h"
+#include <algorithm>
+
+usint ChebyshevDepth(const usint degree) {
+  // upper degree bound for each depth, starting at depth 4
+  static const usint maxDegrees[] = {5, 13, 27, 59, 119, 247, 495, 1007, 2031};
+  usint depth = 4;
+  for (auto maxDegree : maxDegrees) {
+    if (degree <= maxDegree) {
+      return depth;
+    }
+    depth++;
+  }
+  OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+      std::to_string(__LINE__) +
+      std::string("Error: no depth known for a Chebyshev polynomial of degree ") + std::to_string(degree));
+}
+
+DatasetLevels PlanDatasetLevels(const usint weightsLevel, const usint chebPolyDegree, const MatVecLayout layout) {
+  DatasetLevels levels;
+  usint thetaLevel = weightsLevel + 1;
+  usint logitsLevel = thetaLevel + ((layout == MatVecLayout::DIAGONAL) ? 1 : 2);
+  usint predsLevel = logitsLevel + ChebyshevDepth(chebPolyDegree);
+
+  levels.x = thetaLevel;
+  levels.negXt = predsLevel;
+  levels.labels = predsLevel;
+  return levels;
+}
+
+BootstrapScheduler::BootstrapScheduler(usint maxIterationDepth, usint floorLevel, usint maxLevel)
+    : floorLevel(floorLevel), maxLevel(maxLevel) {
+  if (EndLevel(floorLevel, maxIterationDepth) > maxLevel) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) +
+        std::string("Error: an iteration of depth ") + std::to_string(maxIterationDepth) +
+        std::string(" does not fit between level ") + std::to_string(floorLevel) + std::string(" and ") +
+        std::to_string(maxLevel));
+  }
+}
+
+usint BootstrapScheduler::EndLevel(usint level, usint iterationDepth) const {
+  return std::max(level, floorLevel) + iterationDepth;
+}
+
+bool BootstrapScheduler::RefreshBeforeIteration(usint level, usint iterationDepth) {
+  iterations++;
+  if (EndLevel(level, iterationDepth) <= maxLevel) {
+    return false;
+  }
+  refreshes++;
+  return true;
+}
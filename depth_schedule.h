@@ -0,0 +1,104 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#ifndef DPRIVE_ML__DEPTH_SCHEDULE_H_
+#define DPRIVE_ML__DEPTH_SCHEDULE_H_
+
+#include "openfhe.h"
+#include "lr_types.h"
+#include "enc_matrix.h"
+
+////////// Level accounting for one training iteration ///////////////////////////////
+
+/* Levels count the rescalings a ciphertext has been through (0 is a fresh encryption). One
+ * gradient step starting from weights at weightsLevel runs
+ *    extract theta:            + 1    weights * mask
+ *    MatrixVectorProductRow:   + 2    X * theta, mask inside EvalSumCols       -> logits
+ *      (MatrixVectorProductDiag: + 1    no mask with the diagonal layout)
+ *    EvalLogistic:             + ChebyshevDepth(degree)                        -> predictions
+ *    MatrixVectorProductCol:   + 1    NegXt * residual                         -> gradient
+ *      (MatrixTransposeVectorProductDiag: + 1)
+ * Each dataset ciphertext is consumed by one of these steps. Encrypting it at the level of the
+ * operand it meets (rather than at 0) drops the towers EvalMult would discard anyway, so the
+ * dataset is smaller and every product runs over fewer towers.
+ */
+struct DatasetLevels {
+  usint x = 0;       // multiplied with theta
+  usint negXt = 0;   // multiplied with the residual
+  usint labels = 0;  // subtracted from the predictions
+};
+
+//////////////////////////////////////////////////
+// Multiplicative depth OpenFHE's Chebyshev series evaluation (EvalLogistic, EvalChebyshevFunction)
+// consumes for a polynomial of the given degree, see
+// https://github.com/openfheorg/openfhe-development/blob/main/src/pke/examples/FUNCTION_EVALUATION.md
+usint ChebyshevDepth(const usint degree);
+
+//////////////////////////////////////////////////
+// weightsLevel is the level of the packed weights at the start of an iteration: 0 after an
+// interactive re-encryption, the bootstrapping output level otherwise.
+DatasetLevels PlanDatasetLevels(const usint weightsLevel, const usint chebPolyDegree,
+                                const MatVecLayout layout = MatVecLayout::ROW_MAJOR);
+
+//////////////////////////////////////////////////
+/* Decides before every iteration whether the weights have to be refreshed (bootstrapped, or
+ * re-encrypted interactively) instead of refreshing them unconditionally. An iteration starting
+ * from weights at `level` ends at
+ *    max(level, floorLevel) + iterationDepth
+ * since the dataset is encrypted for weights at floorLevel and deeper operands drag the weights
+ * down with them. The weights are only refreshed when that would pass maxLevel, so when the
+ * levels before bootstrapping hold several iterations (see CryptoPlan::itersPerBootstrap), or the
+ * iterations get shallower (see SigmoidSchedule), they share one refresh.
+ */
+class BootstrapScheduler {
+ public:
+  // maxIterationDepth is the depth of the deepest iteration, which has to fit after a refresh
+  BootstrapScheduler(usint maxIterationDepth, usint floorLevel, usint maxLevel);
+
+  // level the weights end the next iteration, of depth iterationDepth, at starting from weights at level
+  usint EndLevel(usint level, usint iterationDepth) const;
+
+  // whether the weights at level have to be refreshed before the next iteration. Counts the
+  //    iteration and, if so, the refresh
+  bool RefreshBeforeIteration(usint level, usint iterationDepth);
+
+  usint Iterations() const { return iterations; }
+  usint Refreshes() const { return refreshes; }
+  usint MaxLevel() const { return maxLevel; }
+
+ private:
+  usint floorLevel;
+  usint maxLevel;
+  usint iterations = 0;
+  usint refreshes = 0;
+};
+
+#endif //DPRIVE_ML__DEPTH_SCHEDULE_H_
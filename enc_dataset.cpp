@@ -0,0 +1,408 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#include "enc_dataset.h"
+#include "encrypt_pipeline.h"
+#include "utils.h"
+#include "utils/debug.h"
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+
+//////////////////////////////////////////////////
+usint ComputeNumShards(const usint numSamples, const usint shardRows) {
+  return (numSamples + shardRows - 1) / shardRows;
+}
+
+//////////////////////////////////////////////////
+MatView GetShardRows(const Mat &inMat, const usint shardI, const usint shardRows) {
+  usint start = shardI * shardRows;
+  usint end = std::min(start + shardRows, usint(inMat.NumRows()));
+  if (start >= end) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) +
+        std::string("Error: shard index out of range"));
+  }
+  return inMat.Rows(start, end);
+}
+
+///////////////////////////////////////////////////////////
+namespace {
+// the label slots of one shard: one label per slot with the diagonal layout, VEC_COL_CLONED otherwise
+Vec PackShardLabels(const Mat &labels, usint shardI, usint shardRows, usint rowSize, usint numSlots,
+                    MatVecLayout layout) {
+  if (layout == MatVecLayout::DIAGONAL) {
+    return PackMatRowMajor(GetShardRows(labels, shardI, shardRows), 1, numSlots);
+  }
+  return PackVecColCloned(GetShardRows(labels, shardI, shardRows), rowSize, numSlots);
+}
+}
+
+EncDataset EncryptDataset(
+    CC &cc,
+    const Mat &X,
+    const Mat &NegXt,
+    const Mat &y,
+    const usint rowSize,
+    const usint numSlots,
+    const KeyPair &keys,
+    usint shardRows,
+    usint numWorkers,
+    bool singleX,
+    double negXtScale,
+    const DatasetLevels &levels,
+    MatVecLayout layout
+) {
+  OPENFHE_DEBUG_FLAG(false);
+  OPENFHE_DEBUG("in EncryptDataset");
+
+  if (X.NumRows() != y.NumRows() || (!singleX && X.NumRows() != NegXt.NumRows())) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) +
+        std::string("Error: X, NegXt and y must have the same number of rows"));
+  }
+  if (singleX && layout == MatVecLayout::DIAGONAL) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) +
+        std::string("Error: a single copy of X needs the row-major layout"));
+  }
+
+  EncDataset data;
+  data.rowSize = rowSize;
+  data.colSize = numSlots / rowSize;
+  data.numSamples = X.NumRows();
+  data.numFeatures = X.NumCols();
+  usint capacity = ShardCapacity(layout, rowSize, numSlots);
+  data.shardRows = (shardRows == 0) ? capacity : shardRows;
+  data.negXtScale = negXtScale;
+  data.singleX = singleX;
+  data.levels = levels;
+  data.layout = layout;
+
+  if (data.shardRows > capacity) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) +
+        std::string("Error: shard rows exceed the rows that fit into a shard"));
+  }
+
+  usint numShards = ComputeNumShards(data.numSamples, data.shardRows);
+  OPENFHE_DEBUGEXP(numShards);
+  usint ctsPerShard = data.CtsPerShard();
+  data.ctX.resize(numShards * ctsPerShard);
+  data.ctNegXt.resize(singleX ? 0 : numShards * ctsPerShard);
+  data.ctY.resize(numShards);
+
+  // y scaled once up front in singleX mode, so shards can still be packed from views
+  Mat scaledY;
+  if (singleX) {
+    scaledY = y;
+    MatrixScalarMult(scaledY, data.LabelScale());
+  }
+  const Mat &labels = singleX ? scaledY : y;
+
+  // Packing is a cheap copy, so one producer keeps the encoding/encryption workers busy
+  EncryptionPipeline pipeline(cc, keys, numWorkers);
+  for (usint shardI = 0; shardI < numShards && layout == MatVecLayout::DIAGONAL; shardI++) {
+    // the diagonals are built per shard, then handed over one by one
+    auto xDiags = PackMatDiagonals(GetShardRows(X, shardI, data.shardRows), rowSize, numSlots, false);
+    auto negXtDiags = PackMatDiagonals(GetShardRows(NegXt, shardI, data.shardRows), rowSize, numSlots, true);
+    for (usint i = 0; i < rowSize; i++) {
+      pipeline.Submit(std::move(xDiags[i]), &data.ctX[shardI * rowSize + i], levels.x);
+      pipeline.Submit(std::move(negXtDiags[i]), &data.ctNegXt[shardI * rowSize + i], levels.negXt);
+    }
+    // one label per slot, like the logits
+    pipeline.Submit(PackShardLabels(labels, shardI, data.shardRows, rowSize, numSlots, layout), &data.ctY[shardI],
+                    levels.labels);
+  }
+  for (usint shardI = 0; shardI < numShards && layout == MatVecLayout::ROW_MAJOR; shardI++) {
+    // a single X is also the gradient matrix, so it stays at the shallower of the two levels
+    pipeline.Submit(PackMatRowMajor(GetShardRows(X, shardI, data.shardRows), rowSize, numSlots), &data.ctX[shardI],
+                    singleX ? std::min(levels.x, levels.negXt) : levels.x);
+    if (!singleX) {
+      pipeline.Submit(PackMatRowMajor(GetShardRows(NegXt, shardI, data.shardRows), rowSize, numSlots),
+                      &data.ctNegXt[shardI], levels.negXt);
+    }
+    pipeline.Submit(PackShardLabels(labels, shardI, data.shardRows, rowSize, numSlots, layout),
+                    &data.ctY[shardI], levels.labels);
+  }
+  auto stats = pipeline.Finish();
+  std::cout << "Encrypted " << stats.numCiphertexts << " ciphertexts with " << pipeline.NumWorkers()
+            << " worker(s) in " << stats.seconds << " s (" << stats.CiphertextsPerSec() << " ciphertexts/s)"
+            << std::endl;
+  return data;
+}
+
+EncDataset ScaleDatasetLabels(
+    CC &cc,
+    const EncDataset &data,
+    const Mat &y,
+    double labelFactor,
+    const KeyPair &keys,
+    usint numWorkers
+) {
+  if (y.NumRows() != data.numSamples) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) +
+        std::string("Error: y must hold the labels the dataset was encrypted from"));
+  }
+  EncDataset scaled = data;
+  scaled.labelFactor = data.labelFactor * labelFactor;
+  Mat labels = y;
+  MatrixScalarMult(labels, scaled.LabelScale());
+
+  usint numSlots = data.rowSize * data.colSize;
+  EncryptionPipeline pipeline(cc, keys, numWorkers);
+  for (usint shardI = 0; shardI < data.NumShards(); shardI++) {
+    pipeline.Submit(PackShardLabels(labels, shardI, data.shardRows, data.rowSize, numSlots, data.layout),
+                    &scaled.ctY[shardI], data.levels.labels);
+  }
+  pipeline.Finish();
+  return scaled;
+}
+
+///////////////////////////////////////////////////////////
+// Encrypted dataset bundle
+namespace {
+const char *BUNDLE_METADATA_FILE = "metadata.txt";
+const int BUNDLE_FORMAT_VERSION = 1;
+
+std::string ShardPath(const std::string &dir, const std::string &name, usint shardI) {
+  return (std::filesystem::path(dir) / (name + "_" + std::to_string(shardI) + ".bin")).string();
+}
+
+// the ciphertext vectors of a bundle and the file name prefix of each
+std::vector<std::pair<std::string, std::vector<CT> *>> BundleCiphertexts(EncDataset &data) {
+  return {{"ct_x", &data.ctX}, {"ct_negxt", &data.ctNegXt}, {"ct_y", &data.ctY}};
+}
+
+void ThrowBundleError(const std::string &dir, const std::string &msg) {
+  OPENFHE_THROW(lbcrypto::config_error, "Encrypted dataset bundle " + dir + ": " + msg);
+}
+
+// parses the key=value lines of metadata.txt. Returns an empty map if there is no bundle in dir
+std::map<std::string, std::string> ReadBundleFields(const std::string &dir) {
+  std::map<std::string, std::string> fields;
+  std::ifstream ifs((std::filesystem::path(dir) / BUNDLE_METADATA_FILE).string());
+  if (!ifs.is_open()) {
+    return fields;
+  }
+  std::string line;
+  while (getline(ifs, line)) {
+    auto eq = line.find('=');
+    if (eq != std::string::npos) {
+      fields[line.substr(0, eq)] = line.substr(eq + 1);
+    }
+  }
+  for (auto name : {"format", "rowSize", "colSize", "shardRows", "numSamples", "numFeatures", "numShards",
+                    "negXtScale", "ringDim", "numSlots", "keyTag"}) {
+    if (fields.find(name) == fields.end()) {
+      ThrowBundleError(dir, std::string("metadata is missing ") + name);
+    }
+  }
+  if (std::stoi(fields["format"]) != BUNDLE_FORMAT_VERSION) {
+    ThrowBundleError(dir, "unsupported format version " + fields["format"]);
+  }
+  return fields;
+}
+}
+
+void SaveEncDataset(const std::string &dir, const CC &cc, const EncDataset &data) {
+  std::filesystem::create_directories(dir);
+  std::cout << "Saving encrypted dataset bundle to " << dir << std::endl;
+
+  usint numShards = data.NumShards();
+  bool ok = true;
+  // ctNegXt is empty with singleX, ctX and ctNegXt hold CtsPerShard() ciphertexts per shard
+  for (auto &named : BundleCiphertexts(const_cast<EncDataset &>(data))) {
+    auto &cts = *named.second;
+#pragma omp parallel for reduction(&&:ok)
+    for (usint ctI = 0; ctI < cts.size(); ctI++) {
+      ok = ok && lbcrypto::Serial::SerializeToFile(ShardPath(dir, named.first, ctI), cts[ctI], lbcrypto::SerType::BINARY);
+    }
+  }
+  if (!ok) {
+    ThrowBundleError(dir, "could not write the shard ciphertexts");
+  }
+
+  // written last so a partially written bundle is never picked up
+  std::ofstream ofs((std::filesystem::path(dir) / BUNDLE_METADATA_FILE).string(), std::ios::out | std::ios::trunc);
+  if (!ofs.is_open()) {
+    ThrowBundleError(dir, "could not write metadata");
+  }
+  ofs.precision(dbl::max_digits10);
+  ofs << "format=" << BUNDLE_FORMAT_VERSION << std::endl
+      << "rowSize=" << data.rowSize << std::endl
+      << "colSize=" << data.colSize << std::endl
+      << "shardRows=" << data.shardRows << std::endl
+      << "numSamples=" << data.numSamples << std::endl
+      << "numFeatures=" << data.numFeatures << std::endl
+      << "numShards=" << numShards << std::endl
+      << "negXtScale=" << data.negXtScale << std::endl
+      << "negXtTailScale=" << data.negXtTailScale << std::endl
+      << "singleX=" << data.singleX << std::endl
+      << "layout=" << MatVecLayoutName(data.layout) << std::endl
+      << "levelX=" << data.levels.x << std::endl
+      << "levelNegXt=" << data.levels.negXt << std::endl
+      << "levelY=" << data.levels.labels << std::endl
+      << "ringDim=" << cc->GetRingDimension() << std::endl
+      << "numSlots=" << cc->GetEncodingParams()->GetBatchSize() << std::endl
+      << "keyTag=" << data.ctX[0]->GetKeyTag() << std::endl;
+}
+
+bool ReadEncDatasetMetadata(const std::string &dir, EncDataset &data) {
+  auto fields = ReadBundleFields(dir);
+  if (fields.empty()) {
+    return false;
+  }
+  data.rowSize = std::stoul(fields["rowSize"]);
+  data.colSize = std::stoul(fields["colSize"]);
+  data.shardRows = std::stoul(fields["shardRows"]);
+  data.numSamples = std::stoul(fields["numSamples"]);
+  data.numFeatures = std::stoul(fields["numFeatures"]);
+  data.negXtScale = std::stod(fields["negXtScale"]);
+  // bundles written before the partial last shard was scaled hold it unscaled
+  data.negXtTailScale = (fields.count("negXtTailScale") != 0) ? std::stod(fields["negXtTailScale"]) : 1.0;
+  // bundles written before single-X mode existed always hold ctNegXt
+  data.singleX = (fields.count("singleX") != 0) && std::stoi(fields["singleX"]) != 0;
+  // and were encrypted at level 0 before the levels were planned
+  data.levels.x = (fields.count("levelX") != 0) ? std::stoul(fields["levelX"]) : 0;
+  data.levels.negXt = (fields.count("levelNegXt") != 0) ? std::stoul(fields["levelNegXt"]) : 0;
+  data.levels.labels = (fields.count("levelY") != 0) ? std::stoul(fields["levelY"]) : 0;
+  data.layout = (fields.count("layout") != 0 && fields["layout"] == MatVecLayoutName(MatVecLayout::DIAGONAL))
+      ? MatVecLayout::DIAGONAL : MatVecLayout::ROW_MAJOR;
+
+  usint numShards = std::stoul(fields["numShards"]);
+  if (numShards != ComputeNumShards(data.numSamples, data.shardRows)) {
+    ThrowBundleError(dir, "shard count does not match numSamples / shardRows");
+  }
+  data.ctX.assign(numShards * data.CtsPerShard(), nullptr);
+  data.ctNegXt.assign(data.singleX ? 0 : numShards * data.CtsPerShard(), nullptr);
+  data.ctY.assign(numShards, nullptr);
+  return true;
+}
+
+void LoadEncDataset(const std::string &dir, const CC &cc, const KeyPair &keys, EncDataset &data) {
+  std::cout << "Loading encrypted dataset bundle from " << dir << std::endl;
+
+  // Validate the layout against the context before reading any ciphertext
+  if (!ReadEncDatasetMetadata(dir, data)) {
+    ThrowBundleError(dir, "no metadata found");
+  }
+  auto fields = ReadBundleFields(dir);
+  std::string ringDim = fields["ringDim"];
+  std::string numSlots = fields["numSlots"];
+  std::string keyTag = fields["keyTag"];
+  usint ccNumSlots = cc->GetEncodingParams()->GetBatchSize();
+  if (std::stoul(ringDim) != cc->GetRingDimension()) {
+    ThrowBundleError(dir, "was encrypted at ring dimension " + ringDim + ", context has " +
+        std::to_string(cc->GetRingDimension()));
+  }
+  if (std::stoul(numSlots) != ccNumSlots || data.rowSize * data.colSize != ccNumSlots) {
+    ThrowBundleError(dir, "packing layout does not match the context's " + std::to_string(ccNumSlots) + " slots");
+  }
+  if (keyTag != keys.secretKey->GetKeyTag()) {
+    ThrowBundleError(dir, "was encrypted under different keys. Reuse the key store (-K) it was created with");
+  }
+
+  for (auto &named : BundleCiphertexts(data)) {
+    auto &cts = *named.second;
+    for (usint ctI = 0; ctI < cts.size(); ctI++) {
+      if (!lbcrypto::Serial::DeserializeFromFile(ShardPath(dir, named.first, ctI), cts[ctI], lbcrypto::SerType::BINARY)) {
+        ThrowBundleError(dir, "could not read " + ShardPath(dir, named.first, ctI));
+      }
+      if (cts[ctI]->GetKeyTag() != keyTag) {
+        ThrowBundleError(dir, ShardPath(dir, named.first, ctI) + " has a mismatching key tag");
+      }
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////
+MiniBatchSchedule::MiniBatchSchedule(usint numShards, usint batchShards, bool shuffle, unsigned int seed)
+    : batchShards(batchShards), shuffle(shuffle), order(numShards), pos(0), rng(seed) {
+  if (numShards == 0 || batchShards == 0 || batchShards > numShards) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) +
+        std::string("Error: mini-batch must hold between 1 and numShards shards"));
+  }
+  std::iota(order.begin(), order.end(), 0);
+  StartPass();
+}
+
+void MiniBatchSchedule::StartPass() {
+  pos = 0;
+  if (shuffle) {
+    std::shuffle(order.begin(), order.end(), rng);
+  }
+}
+
+std::vector<usint> MiniBatchSchedule::NextBatch() {
+  std::vector<usint> batch;
+  batch.reserve(batchShards);
+  while (batch.size() < batchShards) {
+    if (pos == order.size()) {
+      StartPass();
+    }
+    // a batch that straddles two shuffled passes must not pick the same shard twice
+    for (usint j = pos + 1; j < order.size() &&
+        std::find(batch.begin(), batch.end(), order[pos]) != batch.end(); j++) {
+      std::swap(order[pos], order[j]);
+    }
+    batch.push_back(order[pos++]);
+  }
+  return batch;
+}
+
+std::string MiniBatchSchedule::GetState() const {
+  std::stringstream ss;
+  ss << pos << " " << order.size();
+  for (auto shardI : order) {
+    ss << " " << shardI;
+  }
+  ss << " " << rng;
+  return ss.str();
+}
+
+void MiniBatchSchedule::SetState(const std::string &state) {
+  std::stringstream ss(state);
+  size_t numShards;
+  ss >> pos >> numShards;
+  if (!ss || numShards != order.size() || pos > numShards) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) +
+        std::string("Error: mini-batch schedule state does not match the number of shards"));
+  }
+  for (auto &shardI : order) {
+    ss >> shardI;
+  }
+  ss >> rng;
+}
@@ -0,0 +1,171 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#ifndef DPRIVE_ML__ENC_DATASET_H_
+#define DPRIVE_ML__ENC_DATASET_H_
+
+#include <random>
+#include "openfhe.h"
+#include "depth_schedule.h"
+#include "enc_matrix.h"
+#include "lr_types.h"
+
+////////// Row-sharded encrypted training data ///////////////////////////////
+
+/* A ciphertext packs at most colSize = numSlots / rowSize samples, so larger training sets are
+ * split row-wise into shards of shardRows <= colSize samples. Shard i holds samples
+ * [i * shardRows, (i + 1) * shardRows) of
+ *    - ctX:      X in MAT_ROW_MAJOR
+ *    - ctNegXt:  -X' (pre-scaled) in MAT_ROW_MAJOR, i.e. MAT_COL_MAJOR of the transpose
+ *    - ctY:      y in VEC_COL_CLONED
+ * The last shard is zero padded. Zero rows contribute nothing to the gradient since their
+ * -X' columns are zero.
+ *
+ * With singleX only ctX is stored: ctNegXt is empty and ctY holds -negXtScale * y. The gradient
+ * then multiplies ctX by a residual that carries the scale (see EncLogRegCalculateGradient),
+ * halving the encrypted dataset.
+ *
+ * Each ciphertext is encrypted at the level it is consumed at (see depth_schedule.h) instead of at
+ * the top of the modulus chain.
+ *
+ * With the DIAGONAL layout (see enc_matrix.h) a shard holds up to numSlots samples: ctX and ctNegXt
+ * hold rowSize diagonal ciphertexts per shard (shard i at [i * rowSize, (i + 1) * rowSize)) and ctY
+ * one label per slot.
+ */
+struct EncDataset {
+  std::vector<CT> ctX;
+  std::vector<CT> ctNegXt;
+  std::vector<CT> ctY;
+  usint rowSize = 0;      // NextPow2(numFeatures)
+  usint colSize = 0;      // rows packed per ciphertext (numSlots / rowSize)
+  usint shardRows = 0;    // samples per shard, <= ShardCapacity(layout, rowSize, numSlots)
+  usint numSamples = 0;   // original number of samples across all shards
+  usint numFeatures = 0;  // original number of features (including the intercept column)
+  double negXtScale = 0;  // X was scaled by -negXtScale to build NegXt
+  double negXtTailScale = 1; // extra factor of the last shard's NegXt rows (see ComputeTailShardScale)
+  bool singleX = false;   // no ctNegXt, ctY is scaled by LabelScale()
+  double labelFactor = 1; // extra factor ctY was scaled by (see ScaleDatasetLabels)
+  DatasetLevels levels;   // levels the ciphertexts were encrypted at
+  MatVecLayout layout = MatVecLayout::ROW_MAJOR;
+
+  usint NumShards() const { return ctY.size(); }
+  // ciphertexts of ctX (and ctNegXt) per shard
+  usint CtsPerShard() const { return (layout == MatVecLayout::DIAGONAL) ? rowSize : 1; }
+  // factor ctY (and the sigmoid output it is subtracted from) carries
+  double LabelScale() const { return (singleX ? -negXtScale : 1.0) * labelFactor; }
+};
+
+//////////////////////////////////////////////////
+// returns the number of shardRows-row shards needed to hold numSamples rows
+usint ComputeNumShards(const usint numSamples, const usint shardRows);
+
+//////////////////////////////////////////////////
+// returns a view of rows [shardI * shardRows, min((shardI + 1) * shardRows, numRows)) of inMat
+MatView GetShardRows(const Mat &inMat, const usint shardI, const usint shardRows);
+
+///////////////////////////////////////////////////////////
+// splits X, NegXt and y into shardRows-row shards, then encodes and encrypts every shard.
+// shardRows == 0 packs as many rows as fit into one shard (ShardCapacity).
+// Slot vectors are packed on this thread and encoded/encrypted by an EncryptionPipeline of
+// numWorkers threads (0: one per core), which reports the throughput.
+// singleX skips NegXt (which may then be empty) and encrypts y scaled by -negXtScale instead.
+// levels gives the level each kind of ciphertext is encrypted at, layout the packing of X and NegXt.
+EncDataset EncryptDataset(
+    CC &cc,
+    const Mat &X,
+    const Mat &NegXt,
+    const Mat &y,
+    const usint rowSize,
+    const usint numSlots,
+    const KeyPair &keys,
+    usint shardRows = 0,
+    usint numWorkers = 0,
+    bool singleX = false,
+    double negXtScale = 0,
+    const DatasetLevels &levels = DatasetLevels(),
+    MatVecLayout layout = MatVecLayout::ROW_MAJOR
+);
+
+///////////////////////////////////////////////////////////
+// returns a copy of data sharing ctX and ctNegXt, with ctY re-encrypted from y (the labels data was
+// encrypted from) scaled so the gradient comes out labelFactor times larger: with the sigmoid scaled
+// by the new LabelScale() the residual, and so the gradient, carries the factor. Lets several
+// learning rates train on one encrypted X and -X' (see sweep.h)
+EncDataset ScaleDatasetLabels(
+    CC &cc,
+    const EncDataset &data,
+    const Mat &y,
+    double labelFactor,
+    const KeyPair &keys,
+    usint numWorkers = 0
+);
+
+/* Encrypted dataset bundle: a directory holding every shard ciphertext (binary serialization)
+ * plus a metadata.txt with the layout (packing, rowSize, colSize, shardRows, sample/feature counts),
+ * the NegXt scaling factor and the ring dimension, slot count and key tag it was encrypted under.
+ * Reloading a bundle skips CSV parsing, encoding and encryption entirely.
+ */
+void SaveEncDataset(const std::string &dir, const CC &cc, const EncDataset &data);
+
+// reads only metadata.txt into data (no ciphertexts, no context needed).
+// Returns false if dir does not hold a bundle
+bool ReadEncDatasetMetadata(const std::string &dir, EncDataset &data);
+
+// reads the metadata and deserializes the shard ciphertexts into data.
+// Throws if the bundle was not encrypted for cc and keys
+void LoadEncDataset(const std::string &dir, const CC &cc, const KeyPair &keys, EncDataset &data);
+
+/* Hands out the shard indices each mini-batch iteration should consume.
+ * Shards are visited batchShards at a time, either in order or in a fresh random permutation
+ * each pass over the data. A batch that runs past the end of a pass wraps into the next one.
+ */
+class MiniBatchSchedule {
+ public:
+  MiniBatchSchedule(usint numShards, usint batchShards, bool shuffle, unsigned int seed = 42);
+
+  // returns the shard indices for the next iteration
+  std::vector<usint> NextBatch();
+
+  // single-line snapshot of the position, shard order and RNG, used for checkpointing
+  std::string GetState() const;
+  void SetState(const std::string &state);
+
+ private:
+  void StartPass();
+
+  usint batchShards;
+  bool shuffle;
+  std::vector<usint> order;
+  usint pos;
+  std::mt19937 rng;
+};
+
+#endif //DPRIVE_ML__ENC_DATASET_H_
@@ -30,3 +30,114 @@
 //==================================================================================
 
 #include "enc_matrix.h"
+#include <algorithm>
+
+void CheckHoistRadix(usint radix) {
+  if (radix < 2 || (radix & (radix - 1)) != 0) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) +
+        std::string("Error: hoisting radix must be a power of two >= 2, got ") + std::to_string(radix));
+  }
+}
+
+std::vector<int32_t> HoistedRotateSumIndices(int32_t stride, usint count, usint radix) {
+  CheckHoistRadix(radix);
+  std::vector<int32_t> indices;
+  for (usint step = 1; step < count; step *= radix) {
+    usint terms = std::min(radix, count / step);
+    for (usint j = 1; j < terms; j++) {
+      indices.push_back(static_cast<int32_t>(j * step) * stride);
+    }
+    if (terms < radix) {
+      break;
+    }
+  }
+  return indices;
+}
+
+std::vector<int32_t> HoistedMatrixVectorIndices(usint rowSize, usint numSlots, usint radix) {
+  std::vector<int32_t> indices = HoistedRotateSumIndices(1, rowSize, radix);
+  for (auto idx : HoistedRotateSumIndices(-1, rowSize, radix)) {
+    indices.push_back(idx);
+  }
+  for (auto idx : HoistedRotateSumIndices(static_cast<int32_t>(rowSize), numSlots / rowSize, radix)) {
+    indices.push_back(idx);
+  }
+  std::sort(indices.begin(), indices.end());
+  indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+  return indices;
+}
+
+std::string MatVecLayoutName(MatVecLayout layout) {
+  return (layout == MatVecLayout::DIAGONAL) ? "diag" : "row";
+}
+
+usint BsgsBabySteps(usint rowSize) {
+  usint babySteps = 1;
+  while (babySteps * babySteps < rowSize) {
+    babySteps *= 2;
+  }
+  return babySteps;
+}
+
+std::vector<int32_t> DiagonalMatVecIndices(usint rowSize, usint numSlots, usint radix) {
+  usint babySteps = BsgsBabySteps(rowSize);
+  std::vector<int32_t> indices;
+  for (usint b = 1; b < babySteps; b++) {
+    indices.push_back(b);
+  }
+  for (usint a = 1; a < rowSize / babySteps; a++) {
+    indices.push_back(a * babySteps);
+  }
+  for (auto idx : HoistedRotateSumIndices(static_cast<int32_t>(rowSize), numSlots / rowSize, radix)) {
+    indices.push_back(idx);
+  }
+  std::sort(indices.begin(), indices.end());
+  indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+  return indices;
+}
+
+namespace {
+// cost of HoistedRotateSum (or the OpenFHE chain it replaces when radix is 0)
+double RotateSumCost(usint count, usint hoistRadix) {
+  double cost = 0;
+  usint radix = (hoistRadix == 0) ? 2 : hoistRadix;
+  for (usint step = 1; step < count; step *= radix) {
+    usint terms = std::min(radix, count / step);
+    cost += (hoistRadix == 0) ? 1 : HOISTED_ROTATION_COST * terms;  // decomposition + terms - 1 rotations
+    if (terms < radix) {
+      break;
+    }
+  }
+  return cost;
+}
+}
+
+MatVecCost EstimateMatVecCost(MatVecLayout layout, usint numSamples, usint rowSize, usint numSlots, usint hoistRadix) {
+  MatVecCost cost;
+  usint colSize = numSlots / rowSize;
+  double perShard;
+  if (layout == MatVecLayout::ROW_MAJOR) {
+    cost.shards = (numSamples + colSize - 1) / colSize;
+    cost.ciphertexts = 3 * cost.shards;
+    // two relinearizations, the two row sums of EvalSumCols and the column sum of EvalSumRows
+    perShard = 2 + 2 * RotateSumCost(rowSize, hoistRadix) + RotateSumCost(colSize, hoistRadix) + 2 * TENSOR_COST;
+  } else {
+    cost.shards = (numSamples + numSlots - 1) / numSlots;
+    cost.ciphertexts = (2 * rowSize + 1) * cost.shards;
+    usint babySteps = BsgsBabySteps(rowSize);
+    usint giantSteps = rowSize / babySteps;
+    // per product: hoisted baby steps, a relinearization and a rotation per giant step and
+    //    rowSize tensor products; the transposed product adds the block sum
+    double product = HOISTED_ROTATION_COST * babySteps + giantSteps + (giantSteps - 1) + TENSOR_COST * rowSize;
+    perShard = 2 * product + RotateSumCost(colSize, hoistRadix);
+  }
+  cost.keySwitches = perShard * cost.shards;
+  return cost;
+}
+
+MatVecLayout ChooseMatVecLayout(usint numSamples, usint rowSize, usint numSlots, usint hoistRadix) {
+  auto rowMajor = EstimateMatVecCost(MatVecLayout::ROW_MAJOR, numSamples, rowSize, numSlots, hoistRadix);
+  auto diagonal = EstimateMatVecCost(MatVecLayout::DIAGONAL, numSamples, rowSize, numSlots, hoistRadix);
+  return (diagonal.keySwitches < rowMajor.keySwitches) ? MatVecLayout::DIAGONAL : MatVecLayout::ROW_MAJOR;
+}
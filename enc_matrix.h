@@ -35,6 +35,9 @@
 #include "openfhe.h"
 #include "lr_types.h"
 
+// terms summed per hoisted stage of HoistedRotateSum. 0 selects OpenFHE's EvalSumRows/EvalSumCols
+const usint HOIST_RADIX_DEF = 4;
+
 // convert 1d vector to row cloned (input must be zero padded to power of two
 // output is a VEC_ROW_CLONED
 template<typename type>
@@ -84,6 +87,233 @@ void MatrixVectorProductCol(
   cProduct = context->EvalSumRows(cMult, rowSize, *evalSumRows);
 }
 
+////////// Hoisted rotations ///////////////////////////////
+// A rotation is a key switch: decompose the ciphertext into digits and raise them to the extended
+// basis (ModUp), multiply by the rotation key, then scale back down (ModDown). The decomposition
+// only depends on the input, so several rotations of the same ciphertext can share it and pay the
+// ModUp once (EvalFastRotationPrecompute / EvalFastRotation).
+
+// throws unless radix is a power of two >= 2
+void CheckHoistRadix(usint radix);
+
+// Rotation indices HoistedRotateSum(ct, stride, count, radix) uses
+std::vector<int32_t> HoistedRotateSumIndices(int32_t stride, usint count, usint radix);
+
+// Rotation indices MatrixVectorProductRowHoisted and MatrixVectorProductColHoisted use
+std::vector<int32_t> HoistedMatrixVectorIndices(usint rowSize, usint numSlots, usint radix);
+
+// Rotates ct by each of indices, decomposing ct once
+template<typename Element>
+std::vector<lbcrypto::Ciphertext<Element>> HoistedRotations(
+    CC &context,
+    const lbcrypto::Ciphertext<Element> &ct,
+    const std::vector<int32_t> &indices
+) {
+  std::vector<lbcrypto::Ciphertext<Element>> rotated;
+  if (indices.empty()) {
+    return rotated;
+  }
+  auto digits = context->EvalFastRotationPrecompute(ct);
+  usint m = context->GetCyclotomicOrder();
+  rotated.reserve(indices.size());
+  for (auto index : indices) {
+    rotated.push_back(context->EvalFastRotation(ct, index, m, digits));
+  }
+  return rotated;
+}
+
+// Returns sum_{i < count} Rotate(ct, i * stride) for a power of two count, like the log-depth
+// rotate-and-add chain but with radix terms per stage: each stage sums radix - 1 rotations of its
+// input, which share one decomposition. radix 2 is the plain chain. Needs rotation keys for
+// HoistedRotateSumIndices(stride, count, radix)
+template<typename Element>
+lbcrypto::Ciphertext<Element> HoistedRotateSum(
+    CC &context,
+    const lbcrypto::Ciphertext<Element> &ct,
+    int32_t stride,
+    usint count,
+    usint radix = HOIST_RADIX_DEF
+) {
+  CheckHoistRadix(radix);
+  auto acc = ct;
+  for (usint step = 1; step < count; step *= radix) {
+    usint terms = std::min(radix, count / step);
+    std::vector<int32_t> indices;
+    for (usint j = 1; j < terms; j++) {
+      indices.push_back(static_cast<int32_t>(j * step) * stride);
+    }
+    auto rotated = HoistedRotations(context, acc, indices);
+    rotated.push_back(acc);
+    acc = context->EvalAddMany(rotated);
+    if (terms < radix) {
+      break;
+    }
+  }
+  return acc;
+}
+
+// Same result as EvalSumCols: every slot of a rowSize-wide row holds the sum of that row.
+//    Sum within the row (left rotations), keep the first slot of each row, replicate it (right rotations).
+//    ptRowStartMask is encoded once per run, see MakeRowStartMask
+template<typename Element>
+lbcrypto::Ciphertext<Element> HoistedSumCols(
+    CC &context,
+    const lbcrypto::Ciphertext<Element> &ct,
+    uint32_t rowSize,
+    const PT &ptRowStartMask,
+    usint radix = HOIST_RADIX_DEF
+) {
+  auto rowSums = context->EvalMult(HoistedRotateSum(context, ct, 1, rowSize, radix), ptRowStartMask);
+  return HoistedRotateSum(context, rowSums, -1, rowSize, radix);
+}
+
+// Same result as EvalSumRows: every row holds the sum of all rows
+template<typename Element>
+lbcrypto::Ciphertext<Element> HoistedSumRows(
+    CC &context,
+    const lbcrypto::Ciphertext<Element> &ct,
+    uint32_t rowSize,
+    usint radix = HOIST_RADIX_DEF
+) {
+  usint numSlots = context->GetEncodingParams()->GetBatchSize();
+  return HoistedRotateSum(context, ct, static_cast<int32_t>(rowSize), numSlots / rowSize, radix);
+}
+
+template<typename Element>
+void MatrixVectorProductRowHoisted(
+    CC &context,
+    const lbcrypto::Ciphertext<Element> &cMat,
+    const lbcrypto::Ciphertext<Element> &cVecRowCloned,
+    uint32_t rowSize,
+    const PT &ptRowStartMask,
+    lbcrypto::Ciphertext<Element> &cProduct,
+    usint radix = HOIST_RADIX_DEF
+) {
+  auto cMult = context->EvalMult(cMat, cVecRowCloned);
+  cProduct = HoistedSumCols(context, cMult, rowSize, ptRowStartMask, radix);
+}
+
+template<typename Element>
+void MatrixVectorProductColHoisted(
+    CC &context,
+    const lbcrypto::Ciphertext<Element> &cMat,
+    const lbcrypto::Ciphertext<Element> &cVecColCloned,
+    uint32_t rowSize,
+    lbcrypto::Ciphertext<Element> &cProduct,
+    usint radix = HOIST_RADIX_DEF
+) {
+  auto cMult = context->EvalMult(cMat, cVecColCloned);
+  cProduct = HoistedSumRows(context, cMult, rowSize, radix);
+}
+
+////////// Diagonal (Halevi-Shoup) matrix-vector products ///////////////////////////////
+/* MAT_ROW_MAJOR packs numSlots / rowSize samples per ciphertext and reduces every product with
+ * EvalSumCols/EvalSumRows, i.e. O(log rowSize) rotations per ciphertext. With wide rows that is
+ * few samples and many rotations per ciphertext.
+ *
+ * The diagonal layout cuts the samples into rowSize x rowSize blocks and packs diagonal i of every
+ * block into ciphertext i: slot s = blk * rowSize + j holds X[s][(j + i) % rowSize]. A shard is
+ * rowSize such ciphertexts covering numSlots samples, and (block-wise) X theta = sum_i diag_i *
+ * Rotate(theta, i) since theta repeats every rowSize slots. Splitting i = a * g + b (baby steps
+ * b < g, giant steps a < rowSize / g) and pre-rotating the diagonals when packing them (see
+ * PackMatDiagonals) leaves g - 1 hoisted baby rotations of the vector and rowSize / g - 1 giant
+ * rotations, with one relinearization per giant step, for all numSlots samples at once.
+ *
+ * X' r uses the diagonals of -X' packed the same way (PackMatDiagonals(..., true)) and ends with a
+ * sum over the blocks, which leaves the gradient repeated every rowSize slots like EvalSumRows.
+ * The logits come out one per slot (not VEC_COL_CLONED), so the labels are packed that way too.
+ */
+enum class MatVecLayout { ROW_MAJOR, DIAGONAL };
+
+std::string MatVecLayoutName(MatVecLayout layout);
+
+// baby steps g of the rowSize = g * (rowSize / g) split, the power of two closest to sqrt(rowSize)
+usint BsgsBabySteps(usint rowSize);
+
+// Rotation indices the diagonal products use, including the block sum of the transposed product
+std::vector<int32_t> DiagonalMatVecIndices(usint rowSize, usint numSlots, usint radix);
+
+// sum over a < rowSize / g of Rotate(sum over b < g of cDiags[a * g + b] * Rotate(cVec, b), a * g)
+template<typename Element>
+lbcrypto::Ciphertext<Element> BsgsDiagonalSum(
+    CC &context,
+    const std::vector<lbcrypto::Ciphertext<Element>> &cDiags,
+    const lbcrypto::Ciphertext<Element> &cVec,
+    uint32_t rowSize
+) {
+  if (cDiags.size() != rowSize) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) +
+        std::string("Error: expected one diagonal ciphertext per row slot"));
+  }
+  usint babySteps = BsgsBabySteps(rowSize);
+  usint giantSteps = rowSize / babySteps;
+
+  std::vector<int32_t> babyIndices;
+  for (usint b = 1; b < babySteps; b++) {
+    babyIndices.push_back(b);
+  }
+  auto babies = HoistedRotations(context, cVec, babyIndices);
+  babies.insert(babies.begin(), cVec);
+
+  std::vector<lbcrypto::Ciphertext<Element>> giantSums(giantSteps);
+  for (usint a = 0; a < giantSteps; a++) {
+    // the products are summed before relinearizing, one key switch per giant step
+    auto inner = context->EvalMultNoRelin(cDiags[a * babySteps], babies[0]);
+    for (usint b = 1; b < babySteps; b++) {
+      context->EvalAddInPlace(inner, context->EvalMultNoRelin(cDiags[a * babySteps + b], babies[b]));
+    }
+    inner = context->Relinearize(inner);
+    giantSums[a] = (a == 0) ? inner : context->EvalRotate(inner, static_cast<int32_t>(a * babySteps));
+  }
+  return context->EvalAddMany(giantSums);
+}
+
+// X theta from the diagonals of X. cVecRowCloned repeats every rowSize slots, the product holds
+// one logit per slot
+template<typename Element>
+void MatrixVectorProductDiag(
+    CC &context,
+    const std::vector<lbcrypto::Ciphertext<Element>> &cDiags,
+    const lbcrypto::Ciphertext<Element> &cVecRowCloned,
+    uint32_t rowSize,
+    lbcrypto::Ciphertext<Element> &cProduct
+) {
+  cProduct = BsgsDiagonalSum(context, cDiags, cVecRowCloned, rowSize);
+}
+
+// X' r from the transposed diagonals of X, r with one value per slot. The product repeats every
+// rowSize slots. radix is the hoisting radix of the block sum (2 for the plain chain)
+template<typename Element>
+void MatrixTransposeVectorProductDiag(
+    CC &context,
+    const std::vector<lbcrypto::Ciphertext<Element>> &cDiagsT,
+    const lbcrypto::Ciphertext<Element> &cVec,
+    uint32_t rowSize,
+    lbcrypto::Ciphertext<Element> &cProduct,
+    usint radix = HOIST_RADIX_DEF
+) {
+  cProduct = HoistedSumRows(context, BsgsDiagonalSum(context, cDiagsT, cVec, rowSize), rowSize, radix);
+}
+
+////////// Choosing a layout ///////////////////////////////
+// Per-iteration cost of both products over numSamples samples, in key switch equivalents:
+//    a full rotation or relinearization is 1, a hoisted rotation HOISTED_ROTATION_COST
+//    (the shared decomposition is charged once per set), a ciphertext tensor product TENSOR_COST
+const double HOISTED_ROTATION_COST = 0.5;
+const double TENSOR_COST = 0.1;
+
+struct MatVecCost {
+  usint shards = 0;          // encrypted shards holding numSamples
+  usint ciphertexts = 0;     // dataset ciphertexts (X, -X' and y)
+  double keySwitches = 0;    // per iteration, full batch
+};
+
+MatVecCost EstimateMatVecCost(MatVecLayout layout, usint numSamples, usint rowSize, usint numSlots, usint hoistRadix);
+
+// the layout with the lower estimated per-iteration cost
+MatVecLayout ChooseMatVecLayout(usint numSamples, usint rowSize, usint numSlots, usint hoistRadix);
+
 template<typename type>
 void GetVecRowCloned(
     std::vector<type> &inVec, uint32_t numSlots, type paddingVal, std::vector<type> &outVec
@@ -0,0 +1,124 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#include "encrypt_pipeline.h"
+#include <omp.h>
+
+EncryptionPipeline::EncryptionPipeline(CC &cc, const KeyPair &keys, usint numWorkers, usint queueDepth)
+    : cc(cc), keys(keys) {
+  if (numWorkers == 0) {
+    numWorkers = std::max(1U, std::thread::hardware_concurrency());
+  }
+  this->queueDepth = (queueDepth == 0) ? 2 * numWorkers : queueDepth;
+  for (usint i = 0; i < numWorkers; i++) {
+    workers.emplace_back(&EncryptionPipeline::Run, this);
+  }
+}
+
+EncryptionPipeline::~EncryptionPipeline() {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stop = true;
+  }
+  notEmpty.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void EncryptionPipeline::Submit(Vec &&slots, CT *out, usint level) {
+  std::unique_lock<std::mutex> lock(mtx);
+  if (!started) {
+    started = true;
+    startTime = std::chrono::high_resolution_clock::now();
+  }
+  notFull.wait(lock, [this] { return queue.size() < queueDepth; });
+  queue.push_back(Job{std::move(slots), out, level});
+  inFlight++;
+  notEmpty.notify_one();
+}
+
+EncryptionStats EncryptionPipeline::Finish() {
+  std::unique_lock<std::mutex> lock(mtx);
+  idle.wait(lock, [this] { return inFlight == 0; });
+
+  EncryptionStats stats;
+  stats.numCiphertexts = numDone;
+  if (started) {
+    stats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+  }
+  numDone = 0;
+  started = false;
+
+  if (error) {
+    auto toThrow = error;
+    error = nullptr;
+    std::rethrow_exception(toThrow);
+  }
+  return stats;
+}
+
+void EncryptionPipeline::Run() {
+  // the workers already use every core; keep OpenFHE's internal OpenMP loops on this thread
+  omp_set_num_threads(1);
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      notEmpty.wait(lock, [this] { return stop || !queue.empty(); });
+      if (queue.empty()) {
+        return;
+      }
+      job = std::move(queue.front());
+      queue.pop_front();
+    }
+    notFull.notify_one();
+
+    std::exception_ptr jobError;
+    try {
+      // encoding at a deeper level leaves out the towers, so the ciphertext is created without them
+      PT pt = cc->MakeCKKSPackedPlaintext(job.slots, 1, job.level);
+      job.slots = Vec();  // release the packed vector before the slower encryption
+      *job.out = cc->Encrypt(keys.publicKey, pt);
+    } catch (...) {
+      jobError = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (jobError && !error) {
+      error = jobError;
+    }
+    numDone += jobError ? 0 : 1;
+    if (--inFlight == 0) {
+      idle.notify_all();
+    }
+  }
+}
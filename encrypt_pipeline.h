@@ -0,0 +1,99 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#ifndef DPRIVE_ML__ENCRYPT_PIPELINE_H_
+#define DPRIVE_ML__ENCRYPT_PIPELINE_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "openfhe.h"
+#include "lr_types.h"
+
+////////// Pipelined encoding and encryption of packed slot vectors ///////////////////////////////
+
+struct EncryptionStats {
+  usint numCiphertexts = 0;
+  double seconds = 0;
+
+  double CiphertextsPerSec() const { return (seconds > 0) ? numCiphertexts / seconds : 0; }
+};
+
+/* The calling thread packs slot vectors and Submit()s them; a pool of worker threads encodes
+ * (MakeCKKSPackedPlaintext) and encrypts them concurrently. At most queueDepth packed vectors
+ * wait in the queue, Submit() blocks while it is full, so memory stays bounded no matter how
+ * many ciphertexts are produced.
+ */
+class EncryptionPipeline {
+ public:
+  // numWorkers = 0 uses one worker per core, queueDepth = 0 allows two pending vectors per worker
+  EncryptionPipeline(CC &cc, const KeyPair &keys, usint numWorkers = 0, usint queueDepth = 0);
+  ~EncryptionPipeline();
+
+  // queues slots to be encrypted at the given level into *out, which must stay valid until Finish()
+  void Submit(Vec &&slots, CT *out, usint level = 0);
+
+  // waits for every submitted vector, rethrows the first worker error. The pipeline can be reused afterwards
+  EncryptionStats Finish();
+
+  usint NumWorkers() const { return workers.size(); }
+
+ private:
+  struct Job {
+    Vec slots;
+    CT *out;
+    usint level;
+  };
+
+  void Run();
+
+  CC cc;
+  KeyPair keys;
+  usint queueDepth;
+  std::mutex mtx;
+  std::condition_variable notEmpty;
+  std::condition_variable notFull;
+  std::condition_variable idle;
+  std::deque<Job> queue;
+  usint inFlight = 0;
+  usint numDone = 0;
+  bool stop = false;
+  bool started = false;
+  std::chrono::high_resolution_clock::time_point startTime;
+  std::exception_ptr error;
+  std::vector<std::thread> workers;
+};
+
+#endif //DPRIVE_ML__ENCRYPT_PIPELINE_H_
@@ -0,0 +1,195 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#ifndef DPRIVE_ML__FLAT_MATRIX_H_
+#define DPRIVE_ML__FLAT_MATRIX_H_
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+///////// Contiguous row-major plaintext matrix and non-owning views into it ///////////////////////
+
+// Allocates storage aligned to Alignment bytes so rows can be loaded with aligned vector instructions
+template<typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+  typedef T value_type;
+  template<typename U>
+  struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+  AlignedAllocator() = default;
+  template<typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+  T *allocate(size_t n) {
+    size_t numBytes = (n * sizeof(T) + Alignment - 1) / Alignment * Alignment;
+    void *ptr = std::aligned_alloc(Alignment, numBytes);
+    if (!ptr) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T *>(ptr);
+  }
+  void deallocate(T *ptr, size_t) { std::free(ptr); }
+
+  template<typename U>
+  bool operator==(const AlignedAllocator<U, Alignment> &) const { return true; }
+  template<typename U>
+  bool operator!=(const AlignedAllocator<U, Alignment> &) const { return false; }
+};
+
+/* One row of a FlatMatrix. Behaves like a fixed size vector so rows can be indexed, iterated
+ * and passed around without copying
+ */
+template<typename T>
+class RowSpan {
+ public:
+  RowSpan(T *data, size_t size) : ptr(data), len(size) {}
+
+  T &operator[](size_t j) const { return ptr[j]; }
+  size_t size() const { return len; }
+  T *data() const { return ptr; }
+  T *begin() const { return ptr; }
+  T *end() const { return ptr + len; }
+
+ private:
+  T *ptr;
+  size_t len;
+};
+
+/* Non-owning view of a numRows x numCols block. Element (i, j) is at data[i * rowStride + j * colStride],
+ * so a range of rows, a sub-block, a single column or the transpose of a matrix can be viewed in place.
+ */
+template<typename T>
+class MatrixView {
+ public:
+  MatrixView() = default;
+  MatrixView(T *data, size_t numRows, size_t numCols, size_t rowStride, size_t colStride = 1)
+      : data(data), numRows(numRows), numCols(numCols), rowStride(rowStride), colStride(colStride) {}
+
+  // a view of mutable elements is also a view of const ones
+  operator MatrixView<const T>() const { return MatrixView<const T>(data, numRows, numCols, rowStride, colStride); }
+
+  T &operator()(size_t i, size_t j) const { return data[i * rowStride + j * colStride]; }
+
+  size_t NumRows() const { return numRows; }
+  size_t NumCols() const { return numCols; }
+  size_t RowStride() const { return rowStride; }
+  size_t ColStride() const { return colStride; }
+  T *Data() const { return data; }
+  bool Empty() const { return numRows == 0 || numCols == 0; }
+
+  // true if row i is numCols consecutive elements
+  bool RowsContiguous() const { return colStride == 1; }
+
+  MatrixView Block(size_t row, size_t col, size_t blockRows, size_t blockCols) const {
+    if (row + blockRows > numRows || col + blockCols > numCols) {
+      throw std::invalid_argument("MatrixView::Block out of range");
+    }
+    return MatrixView(data + row * rowStride + col * colStride, blockRows, blockCols, rowStride, colStride);
+  }
+  // rows [start, end)
+  MatrixView Rows(size_t start, size_t end) const { return Block(start, 0, end - start, numCols); }
+  MatrixView Col(size_t j) const { return Block(0, j, numRows, 1); }
+  MatrixView Transposed() const { return MatrixView(data, numCols, numRows, colStride, rowStride); }
+
+ private:
+  T *data = nullptr;
+  size_t numRows = 0;
+  size_t numCols = 0;
+  size_t rowStride = 0;
+  size_t colStride = 1;
+};
+
+/* Dense row-major matrix in a single aligned allocation. Vectors are matrices with a singleton
+ * dimension. A[i] is a RowSpan so A[i][j] indexing works as it did for a vector of rows.
+ */
+template<typename T>
+class FlatMatrix {
+ public:
+  FlatMatrix() = default;
+  FlatMatrix(size_t numRows, size_t numCols, T val = T())
+      : numRows(numRows), numCols(numCols), values(numRows * numCols, val) {}
+
+  // deep copy of a (possibly strided) view
+  explicit FlatMatrix(MatrixView<const T> view) : FlatMatrix(view.NumRows(), view.NumCols()) {
+    for (size_t i = 0; i < numRows; i++) {
+      if (view.RowsContiguous()) {
+        std::copy_n(&view(i, 0), numCols, (*this)[i].data());
+      } else {
+        for (size_t j = 0; j < numCols; j++) {
+          values[i * numCols + j] = view(i, j);
+        }
+      }
+    }
+  }
+
+  RowSpan<T> operator[](size_t i) { return RowSpan<T>(values.data() + i * numCols, numCols); }
+  RowSpan<const T> operator[](size_t i) const { return RowSpan<const T>(values.data() + i * numCols, numCols); }
+  T &operator()(size_t i, size_t j) { return values[i * numCols + j]; }
+  const T &operator()(size_t i, size_t j) const { return values[i * numCols + j]; }
+
+  size_t NumRows() const { return numRows; }
+  size_t NumCols() const { return numCols; }
+  size_t NumElements() const { return values.size(); }
+  bool Empty() const { return values.empty(); }
+  T *Data() { return values.data(); }
+  const T *Data() const { return values.data(); }
+
+  MatrixView<T> View() { return MatrixView<T>(values.data(), numRows, numCols, numCols); }
+  MatrixView<const T> View() const { return MatrixView<const T>(values.data(), numRows, numCols, numCols); }
+  operator MatrixView<const T>() const { return View(); }
+
+  // rows [start, end) without copying
+  MatrixView<const T> Rows(size_t start, size_t end) const { return View().Rows(start, end); }
+
+  /* Grows the matrix by newRows zeroed rows of cols columns and returns a pointer to the first
+   * new element. cols must match unless the matrix is empty.
+   */
+  T *AppendRows(size_t newRows, size_t cols) {
+    if (!Empty() && cols != numCols) {
+      throw std::invalid_argument("FlatMatrix::AppendRows column count mismatch");
+    }
+    size_t firstNew = numRows * cols;
+    numCols = cols;
+    numRows += newRows;
+    values.resize(numRows * numCols);
+    return values.data() + firstNew;
+  }
+
+ private:
+  size_t numRows = 0;
+  size_t numCols = 0;
+  std::vector<T, AlignedAllocator<T>> values;
+};
+
+#endif //DPRIVE_ML__FLAT_MATRIX_H_
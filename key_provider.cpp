@@ -0,0 +1,162 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "key_provider.h"
+#include <filesystem>
+#include <iomanip>
+
+namespace {
+using KeyMap = std::map<usint, lbcrypto::EvalKey<lbcrypto::DCRTPoly>>;
+}
+
+KeyProvider::KeyProvider(const std::string &dir, const std::string &keyTag, double maxResidentMB, bool reuseFiles,
+                         bool removeFiles)
+    : dir(dir), maxResidentMB(maxResidentMB), removeFiles(removeFiles) {
+  keyMap = lbcrypto::CryptoContextImpl<lbcrypto::DCRTPoly>::GetEvalAutomorphismKeyMapPtr(keyTag);
+  std::filesystem::create_directories(dir);
+  for (auto &[index, key] : *keyMap) {
+    KeyFile file;
+    file.path = (std::filesystem::path(dir) / ("key_" + std::to_string(index) + ".bin")).string();
+    if (!reuseFiles || !std::filesystem::exists(file.path)) {
+      KeyMap single = {{index, key}};
+      if (!lbcrypto::Serial::SerializeToFile(file.path, single, lbcrypto::SerType::BINARY)) {
+        OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+            std::to_string(__LINE__) + std::string("Error: could not write ") + file.path);
+      }
+    }
+    file.mb = std::filesystem::file_size(file.path) / double(1 << 20);
+    totalMB += file.mb;
+    keys[index] = file;
+  }
+  // every key starts on disk, the first Require of each group loads it
+  keyMap->clear();
+}
+
+KeyProvider::~KeyProvider() {
+  if (removeFiles) {
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+  }
+}
+
+void KeyProvider::AddGroup(const std::string &name, const std::vector<usint> &automorphismIndices) {
+  groups[name] = std::set<usint>(automorphismIndices.begin(), automorphismIndices.end());
+}
+
+void KeyProvider::Evict(usint index) {
+  auto &file = keys.at(index);
+  keyMap->erase(index);
+  lruOrder.erase(file.lru);
+  file.resident = false;
+  residentMB -= file.mb;
+  evictions++;
+}
+
+void KeyProvider::Require(const std::string &name) {
+  auto group = groups.find(name);
+  if (group == groups.end()) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) + std::string("Error: no key group ") + name);
+  }
+
+  double neededMB = 0;
+  for (auto index : group->second) {
+    auto file = keys.find(index);
+    if (file == keys.end()) {
+      OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+          std::to_string(__LINE__) + std::string("Error: group ") + name + std::string(" needs automorphism key ") +
+          std::to_string(index) + std::string(", which was never generated"));
+    }
+    if (file->second.resident) {
+      hits++;
+      lruOrder.splice(lruOrder.begin(), lruOrder, file->second.lru);
+    } else {
+      neededMB += file->second.mb;
+    }
+  }
+
+  // make room before loading so the peak stays at the cap where the group allows it
+  auto it = lruOrder.end();
+  while (it != lruOrder.begin() && residentMB + neededMB > maxResidentMB) {
+    --it;
+    if (group->second.count(*it) == 0) {
+      usint index = *it;
+      ++it;  // still valid once index is erased
+      Evict(index);
+    }
+  }
+
+  usint loaded = 0;
+  TimeVar t;
+  TIC(t);
+  for (auto index : group->second) {
+    auto &file = keys.at(index);
+    if (file.resident) {
+      continue;
+    }
+    KeyMap single;
+    if (!lbcrypto::Serial::DeserializeFromFile(file.path, single, lbcrypto::SerType::BINARY) ||
+        single.count(index) == 0) {
+      OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+          std::to_string(__LINE__) + std::string("Error: could not read ") + file.path);
+    }
+    (*keyMap)[index] = single[index];
+    lruOrder.push_front(index);
+    file.lru = lruOrder.begin();
+    file.resident = true;
+    residentMB += file.mb;
+    misses++;
+    loaded++;
+  }
+  peakResidentMB = std::max(peakResidentMB, residentMB);
+  if (loaded > 0) {
+    double ms = TOC(t);
+    loadMs += ms;
+    std::cout << "\tLoaded " << loaded << " " << name << " keys (" << std::fixed << std::setprecision(1)
+              << neededMB << " MB) in " << ms / 1000.0 << " s, " << residentMB << " MB resident"
+              << std::defaultfloat << std::setprecision(6) << std::endl;
+  }
+}
+
+void KeyProvider::PrintStats() const {
+  std::cout << "Key provider: " << keys.size() << " keys, " << std::fixed << std::setprecision(1) << totalMB
+            << " MB on disk, " << maxResidentMB << " MB cap, " << peakResidentMB << " MB peak resident" << std::endl;
+  std::cout << "\t" << hits << " hits, " << misses << " misses (loads) taking " << loadMs / 1000.0 << " s, "
+            << evictions << " evictions" << std::defaultfloat << std::setprecision(6) << std::endl;
+}
+
+std::vector<usint> RotationAutomorphismIndices(const std::vector<int32_t> &rotations, usint cyclotomicOrder) {
+  std::vector<usint> indices;
+  indices.reserve(rotations.size());
+  for (auto rotation : rotations) {
+    indices.push_back(lbcrypto::FindAutomorphismIndex2nComplex(rotation, cyclotomicOrder));
+  }
+  return indices;
+}
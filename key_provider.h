@@ -0,0 +1,119 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef DPRIVE_ML__KEY_PROVIDER_H_
+#define DPRIVE_ML__KEY_PROVIDER_H_
+
+#include <list>
+#include <map>
+#include <set>
+#include "openfhe.h"
+#include "lr_types.h"
+
+////////// Loading the automorphism keys on demand ///////////////////////////////
+
+/* A bootstrapped context at ring dimension 2^17 keeps gigabytes of rotation and bootstrapping
+ * keys resident for the whole run, although an iteration and a bootstrap use mostly different
+ * keys. The provider moves every automorphism key of a secret key out of the context into one
+ * file per key and puts keys back into the context's key map when a group that needs them runs:
+ *    - a group is a named set of automorphism indices, e.g. the rotations of an iteration or
+ *      the keys EvalBootstrapKeyGen generated
+ *    - Require(group) loads the missing keys of the group, first evicting the least recently
+ *      used keys outside the group while the resident keys would exceed the cap
+ *    - the keys of the running group are never evicted, so a group larger than the cap still
+ *      runs, with the cap exceeded while it does
+ * The files are read with ordinary buffered reads: deserializing copies every key into its
+ * polynomials anyway, so mapping them would not save memory and the page cache already keeps
+ * recently read files.
+ */
+class KeyProvider {
+ public:
+  /**
+   * @param dir             directory of the key files, created if needed
+   * @param keyTag          tag of the secret key whose automorphism keys are moved out
+   * @param maxResidentMB   cap on the resident keys (by their serialized size)
+   * @param reuseFiles      keep key files already in dir, only valid if they hold the same keys
+   * @param removeFiles     delete dir when the provider is destroyed
+   */
+  KeyProvider(const std::string &dir, const std::string &keyTag, double maxResidentMB, bool reuseFiles,
+              bool removeFiles);
+  ~KeyProvider();
+
+  KeyProvider(const KeyProvider &) = delete;
+  KeyProvider &operator=(const KeyProvider &) = delete;
+
+  // indices without a key file are an error when the group is required
+  void AddGroup(const std::string &name, const std::vector<usint> &automorphismIndices);
+
+  // makes every key of the group resident, see above
+  void Require(const std::string &name);
+
+  usint NumKeys() const { return keys.size(); }
+  double TotalMB() const { return totalMB; }
+  double ResidentMB() const { return residentMB; }
+  double PeakResidentMB() const { return peakResidentMB; }
+  usint Hits() const { return hits; }
+  usint Misses() const { return misses; }  // every miss is one key loaded from disk
+  usint Evictions() const { return evictions; }
+  double LoadMs() const { return loadMs; }
+
+  void PrintStats() const;
+
+ private:
+  struct KeyFile {
+    std::string path;
+    double mb = 0;
+    bool resident = false;
+    std::list<usint>::iterator lru;  // position in lruOrder while resident
+  };
+
+  void Evict(usint index);
+
+  std::string dir;
+  double maxResidentMB;
+  bool removeFiles;
+  std::shared_ptr<std::map<usint, lbcrypto::EvalKey<lbcrypto::DCRTPoly>>> keyMap;
+  std::map<usint, KeyFile> keys;
+  std::map<std::string, std::set<usint>> groups;
+  std::list<usint> lruOrder;  // resident keys, most recently required first
+
+  double totalMB = 0;
+  double residentMB = 0;
+  double peakResidentMB = 0;
+  usint hits = 0;
+  usint misses = 0;
+  usint evictions = 0;
+  double loadMs = 0;
+};
+
+// automorphism indices of the CKKS rotations by each of rotations
+std::vector<usint> RotationAutomorphismIndices(const std::vector<int32_t> &rotations, usint cyclotomicOrder);
+
+#endif //DPRIVE_ML__KEY_PROVIDER_H_
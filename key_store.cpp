@@ -0,0 +1,232 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#include "key_store.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include "utils/debug.h"
+
+namespace {
+const char *FINGERPRINT_FILE = "fingerprint.txt";
+const char *CONTEXT_FILE = "cryptocontext.bin";
+const char *PUBLIC_KEY_FILE = "key_public.bin";
+const char *SECRET_KEY_FILE = "key_secret.bin";
+const char *MULT_KEY_FILE = "key_eval_mult.bin";
+const char *SUM_KEY_FILE = "key_eval_sum.bin";
+const char *AUTOMORPHISM_KEY_FILE = "key_eval_automorphism.bin";
+const char *SUM_ROWS_KEY_FILE = "key_eval_sum_rows.bin";
+const char *SUM_COLS_KEY_FILE = "key_eval_sum_cols.bin";
+const char *BOOTSTRAP_KEY_INDICES_FILE = "bootstrap_key_indices.txt";
+
+void FailIO(const std::string &what, const std::string &path) {
+  std::cerr << "KeyStore: could not " << what << " " << path << std::endl;
+  exit(EXIT_FAILURE);
+}
+}
+
+std::string CryptoFingerprint(
+    const CryptoParams &parameters,
+    bool withBT,
+    const std::vector<uint32_t> &levelBudget,
+    usint rowSize,
+    usint numSlotsBoot,
+    usint hoistRadix,
+    MatVecLayout layout
+) {
+  std::stringstream ss;
+  ss << "nativeInt=" << NATIVEINT
+     << ";ringDim=" << parameters.GetRingDim()
+     << ";multDepth=" << parameters.GetMultiplicativeDepth()
+     << ";scalingModSize=" << parameters.GetScalingModSize()
+     << ";firstModSize=" << parameters.GetFirstModSize()
+     << ";batchSize=" << parameters.GetBatchSize()
+     << ";securityLevel=" << parameters.GetSecurityLevel()
+     << ";scalingTechnique=" << parameters.GetScalingTechnique()
+     << ";keySwitchTechnique=" << parameters.GetKeySwitchTechnique()
+     << ";numLargeDigits=" << parameters.GetNumLargeDigits()
+     << ";secretKeyDist=" << parameters.GetSecretKeyDist()
+     << ";withBT=" << withBT
+     << ";levelBudget=";
+  for (auto &l : levelBudget) {
+    ss << l << ",";
+  }
+  ss << ";rowSize=" << rowSize
+     << ";numSlotsBoot=" << numSlotsBoot
+     << ";hoistRadix=" << hoistRadix
+     << ";matVecLayout=" << MatVecLayoutName(layout);
+  return ss.str();
+}
+
+KeyStore::KeyStore(const std::string &rootDir, const std::string &fingerprint) : fingerprint(fingerprint) {
+  std::stringstream ss;
+  ss << std::hex << std::setw(16) << std::setfill('0') << std::hash<std::string>{}(fingerprint);
+  dir = (std::filesystem::path(rootDir) / ss.str()).string();
+}
+
+std::string KeyStore::Path(const std::string &name) const {
+  return (std::filesystem::path(dir) / name).string();
+}
+
+bool KeyStore::Exists() const {
+  std::ifstream ifs(Path(FINGERPRINT_FILE));
+  if (!ifs.is_open()) {
+    return false;
+  }
+  std::stringstream stored;
+  stored << ifs.rdbuf();
+  if (stored.str() != fingerprint) {
+    std::cout << "KeyStore: fingerprint in " << dir << " does not match, regenerating" << std::endl;
+    return false;
+  }
+  for (auto name : {CONTEXT_FILE, PUBLIC_KEY_FILE, SECRET_KEY_FILE, MULT_KEY_FILE, SUM_KEY_FILE,
+                    AUTOMORPHISM_KEY_FILE, SUM_ROWS_KEY_FILE, SUM_COLS_KEY_FILE, BOOTSTRAP_KEY_INDICES_FILE}) {
+    if (!std::filesystem::exists(Path(name))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void KeyStore::Save(const CC &cc, const KeyPair &keys, const MatKeys &rowKeys, const MatKeys &colKeys,
+                    const std::vector<usint> &bootstrapKeyIndices) const {
+  std::filesystem::create_directories(dir);
+  std::cout << "KeyStore: saving context and keys to " << dir << std::endl;
+
+  if (!lbcrypto::Serial::SerializeToFile(Path(CONTEXT_FILE), cc, lbcrypto::SerType::BINARY)) {
+    FailIO("write", Path(CONTEXT_FILE));
+  }
+  if (!lbcrypto::Serial::SerializeToFile(Path(PUBLIC_KEY_FILE), keys.publicKey, lbcrypto::SerType::BINARY)) {
+    FailIO("write", Path(PUBLIC_KEY_FILE));
+  }
+  if (!lbcrypto::Serial::SerializeToFile(Path(SECRET_KEY_FILE), keys.secretKey, lbcrypto::SerType::BINARY)) {
+    FailIO("write", Path(SECRET_KEY_FILE));
+  }
+  {
+    std::ofstream ofs(Path(MULT_KEY_FILE), std::ios::out | std::ios::binary);
+    if (!ofs.is_open() || !cc->SerializeEvalMultKey(ofs, lbcrypto::SerType::BINARY)) {
+      FailIO("write", Path(MULT_KEY_FILE));
+    }
+  }
+  {
+    std::ofstream ofs(Path(SUM_KEY_FILE), std::ios::out | std::ios::binary);
+    if (!ofs.is_open() || !cc->SerializeEvalSumKey(ofs, lbcrypto::SerType::BINARY)) {
+      FailIO("write", Path(SUM_KEY_FILE));
+    }
+  }
+  {
+    // rotation keys and the bootstrapping keys all live in the automorphism key map
+    std::ofstream ofs(Path(AUTOMORPHISM_KEY_FILE), std::ios::out | std::ios::binary);
+    if (!ofs.is_open() || !cc->SerializeEvalAutomorphismKey(ofs, lbcrypto::SerType::BINARY)) {
+      FailIO("write", Path(AUTOMORPHISM_KEY_FILE));
+    }
+  }
+  if (!lbcrypto::Serial::SerializeToFile(Path(SUM_ROWS_KEY_FILE), *rowKeys, lbcrypto::SerType::BINARY)) {
+    FailIO("write", Path(SUM_ROWS_KEY_FILE));
+  }
+  if (!lbcrypto::Serial::SerializeToFile(Path(SUM_COLS_KEY_FILE), *colKeys, lbcrypto::SerType::BINARY)) {
+    FailIO("write", Path(SUM_COLS_KEY_FILE));
+  }
+  {
+    std::ofstream ofs(Path(BOOTSTRAP_KEY_INDICES_FILE), std::ios::out | std::ios::trunc);
+    if (!ofs.is_open()) {
+      FailIO("write", Path(BOOTSTRAP_KEY_INDICES_FILE));
+    }
+    for (auto index : bootstrapKeyIndices) {
+      ofs << index << " ";
+    }
+  }
+
+  // written last so a partially written store is never considered complete
+  std::ofstream ofs(Path(FINGERPRINT_FILE), std::ios::out | std::ios::trunc);
+  if (!ofs.is_open()) {
+    FailIO("write", Path(FINGERPRINT_FILE));
+  }
+  ofs << fingerprint;
+}
+
+void KeyStore::Load(CC &cc, KeyPair &keys, MatKeys &rowKeys, MatKeys &colKeys,
+                    std::vector<usint> &bootstrapKeyIndices) const {
+  std::cout << "KeyStore: loading context and keys from " << dir << std::endl;
+
+  // Start from a clean slate so the deserialized keys are not mixed with stale ones
+  lbcrypto::CryptoContextImpl<lbcrypto::DCRTPoly>::ClearEvalMultKeys();
+  lbcrypto::CryptoContextImpl<lbcrypto::DCRTPoly>::ClearEvalAutomorphismKeys();
+  lbcrypto::CryptoContextFactory<lbcrypto::DCRTPoly>::ReleaseAllContexts();
+
+  if (!lbcrypto::Serial::DeserializeFromFile(Path(CONTEXT_FILE), cc, lbcrypto::SerType::BINARY)) {
+    FailIO("read", Path(CONTEXT_FILE));
+  }
+  if (!lbcrypto::Serial::DeserializeFromFile(Path(PUBLIC_KEY_FILE), keys.publicKey, lbcrypto::SerType::BINARY)) {
+    FailIO("read", Path(PUBLIC_KEY_FILE));
+  }
+  if (!lbcrypto::Serial::DeserializeFromFile(Path(SECRET_KEY_FILE), keys.secretKey, lbcrypto::SerType::BINARY)) {
+    FailIO("read", Path(SECRET_KEY_FILE));
+  }
+  {
+    std::ifstream ifs(Path(MULT_KEY_FILE), std::ios::in | std::ios::binary);
+    if (!ifs.is_open() || !cc->DeserializeEvalMultKey(ifs, lbcrypto::SerType::BINARY)) {
+      FailIO("read", Path(MULT_KEY_FILE));
+    }
+  }
+  {
+    std::ifstream ifs(Path(SUM_KEY_FILE), std::ios::in | std::ios::binary);
+    if (!ifs.is_open() || !cc->DeserializeEvalSumKey(ifs, lbcrypto::SerType::BINARY)) {
+      FailIO("read", Path(SUM_KEY_FILE));
+    }
+  }
+  {
+    std::ifstream ifs(Path(AUTOMORPHISM_KEY_FILE), std::ios::in | std::ios::binary);
+    if (!ifs.is_open() || !cc->DeserializeEvalAutomorphismKey(ifs, lbcrypto::SerType::BINARY)) {
+      FailIO("read", Path(AUTOMORPHISM_KEY_FILE));
+    }
+  }
+  rowKeys = std::make_shared<std::map<usint, lbcrypto::EvalKey<lbcrypto::DCRTPoly>>>();
+  if (!lbcrypto::Serial::DeserializeFromFile(Path(SUM_ROWS_KEY_FILE), *rowKeys, lbcrypto::SerType::BINARY)) {
+    FailIO("read", Path(SUM_ROWS_KEY_FILE));
+  }
+  colKeys = std::make_shared<std::map<usint, lbcrypto::EvalKey<lbcrypto::DCRTPoly>>>();
+  if (!lbcrypto::Serial::DeserializeFromFile(Path(SUM_COLS_KEY_FILE), *colKeys, lbcrypto::SerType::BINARY)) {
+    FailIO("read", Path(SUM_COLS_KEY_FILE));
+  }
+  {
+    std::ifstream ifs(Path(BOOTSTRAP_KEY_INDICES_FILE));
+    if (!ifs.is_open()) {
+      FailIO("read", Path(BOOTSTRAP_KEY_INDICES_FILE));
+    }
+    bootstrapKeyIndices.clear();
+    usint index;
+    while (ifs >> index) {
+      bootstrapKeyIndices.push_back(index);
+    }
+  }
+}
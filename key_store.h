@@ -0,0 +1,88 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#ifndef DPRIVE_ML__KEY_STORE_H_
+#define DPRIVE_ML__KEY_STORE_H_
+
+#include <string>
+#include "openfhe.h"
+#include "lr_types.h"
+#include "enc_matrix.h"
+
+////////// On-disk store of the crypto context and every key set ///////////////////////////////
+
+/* Builds the string that identifies a key set: every crypto parameter that changes the context,
+ * plus the packing layout (rowSize) and the sparse bootstrapping slots, which change which
+ * rotation and bootstrapping keys exist, as do the radix of the hoisted sums (0 for none) and the
+ * matrix-vector layout (the diagonal products add baby and giant step keys).
+ */
+std::string CryptoFingerprint(
+    const CryptoParams &parameters,
+    bool withBT,
+    const std::vector<uint32_t> &levelBudget,
+    usint rowSize,
+    usint numSlotsBoot,
+    usint hoistRadix,
+    MatVecLayout layout = MatVecLayout::ROW_MAJOR
+);
+
+/* Serializes the crypto context, the key pair, the EvalMult keys, the EvalSum and
+ * automorphism (rotation + bootstrapping) keys and the EvalSumRows/EvalSumCols key maps into
+ * <rootDir>/<hash of fingerprint>/ using binary serialization. The EvalSum sets are empty unless
+ * the run sums with EvalSumRows/EvalSumCols (see PlanRotationKeys). The automorphism indices
+ * EvalBootstrapKeyGen added are stored too, for the KeyProvider's bootstrapping group.
+ *
+ * The fingerprint is stored next to the keys and checked on load, so a store built for
+ * different parameters is never picked up by accident.
+ */
+class KeyStore {
+ public:
+  KeyStore(const std::string &rootDir, const std::string &fingerprint);
+
+  // true if a complete store for this fingerprint exists on disk
+  bool Exists() const;
+
+  void Save(const CC &cc, const KeyPair &keys, const MatKeys &rowKeys, const MatKeys &colKeys,
+            const std::vector<usint> &bootstrapKeyIndices) const;
+
+  // replaces cc, keys, rowKeys, colKeys and bootstrapKeyIndices by the stored ones
+  void Load(CC &cc, KeyPair &keys, MatKeys &rowKeys, MatKeys &colKeys, std::vector<usint> &bootstrapKeyIndices) const;
+
+  const std::string &GetDir() const { return dir; }
+
+ private:
+  std::string Path(const std::string &name) const;
+
+  std::string fingerprint;
+  std::string dir;
+};
+
+#endif //DPRIVE_ML__KEY_STORE_H_
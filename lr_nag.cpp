@@ -38,12 +38,23 @@
 //#define ENABLE_DEBUG
 
 #include "openfhe.h"
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
+#include <set>
 #include "data_io.h"
+#include "checkpoint.h"
+#include "crypto_planner.h"
+#include "depth_schedule.h"
+#include "enc_dataset.h"
+#include "key_provider.h"
+#include "key_store.h"
 #include "lr_train_funcs.h"
 #include "lr_types.h"
 #include "utils.h"
 #include "parameters.h"
+#include "precision_monitor.h"
+#include "sweep.h"
 
 /////////////////////////////////////////////////////////
 // Global Values
@@ -56,7 +67,7 @@ std::string TRAIN_X_FILE_DEF = "train_data/X_norm_1024.csv";
 std::string TRAIN_Y_FILE_DEF = "train_data/y_1024.csv";
 std::string TEST_X_FILE_DEF = "train_data/X_norm.csv";
 std::string TEST_Y_FILE_DEF = "train_data/y.csv";
-uint32_t RING_DIM_DEF(1 << 17);
+uint32_t RING_DIM_DEF(0);  // 0 lets the crypto planner pick the smallest secure ring dimension
 float LR_GAMMA(0.1);  // Learning Rate
 float LR_ETA(0.1);   // Learning Rate
 
@@ -71,6 +82,9 @@ int CHEBYSHEV_RANGE_ESTIMATION_END = 16;
 int CHEBYSHEV_ESTIMATION_DEGREE = 59;
 bool DEBUG = true;
 int DEBUG_PLAINTEXT_LENGTH = 32;
+// KeyProvider groups: the rotations of an iteration and the bootstrapping keys
+const std::string ITERATION_KEY_GROUP = "iteration";
+const std::string BOOTSTRAP_KEY_GROUP = "bootstrapping";
 
 // If we are in the 64-bit case, we may want to run bootstrapping twice
 //    As this will increase our precision, which will make our results
@@ -79,38 +93,6 @@ int DEBUG_PLAINTEXT_LENGTH = 32;
 //    we run single-bootstrapping.
 int BOOTSTRAP_PRECISION_DEF(0);
 
-void debugWeights(
-    CC cc, KeyPair keys, const CT& ctWeights,
-    const PT& ptExtractThetaMask,
-    const PT& ptExtractPhiMask,
-    int signedRowSize,
-    int slotsBoot
-) {
-    std::cout << "\tIn DebugWeights function - Separating Theta and Phi" << std::endl;
-  CT _ctTheta_DBG = cc->EvalMult(ctWeights, ptExtractThetaMask);
-  CT ctTheta_DBG = cc->EvalAdd(
-      cc->EvalRotate(_ctTheta_DBG, signedRowSize),
-      _ctTheta_DBG
-      );
-  CT _ctPhi_DBG = cc->EvalMult(ctWeights, ptExtractPhiMask);
-  CT ctPhi_DBG = cc->EvalAdd(
-      cc->EvalRotate(_ctPhi_DBG, -signedRowSize),
-      _ctPhi_DBG
-  );
-
-  PT ptTheta;
-  PT ptPhi;
-  cc->Decrypt(keys.secretKey, ctTheta_DBG, &ptTheta);
-  cc->Decrypt(keys.secretKey, ctPhi_DBG, &ptPhi);
-  ptTheta->SetLength(slotsBoot);
-  ptPhi->SetLength(slotsBoot);
-
-  std::cout << "\t\tTHETA: " << ptTheta << std::endl;
-  std::cout << "\t\tPHI: " << ptPhi << std::endl;
-
-    std::cout << "\tExiting DebugWeights function" << std::endl;
-}
-
 int main(int argc, char *argv[]) {
 
   OPENFHE_DEBUG_FLAG(false);
@@ -130,216 +112,537 @@ int main(int argc, char *argv[]) {
   /////////////////////////////////////////////////////////
   // Handle IO for writing
   /////////////////////////////////////////////////////////
-  std::ofstream ofsloss;
-  ofsloss.precision(params.outputPrecision);
-  ofsloss.open(params.lossOutFile);
-  if (!ofsloss.is_open()) {
-    std::cerr << "Could not open file to write train loss to " << params.lossOutFile << std::endl;
-    exit(EXIT_FAILURE);
+  // When resuming, the output files are cut back to where the checkpoint was taken and appended to,
+  //    so lines written after the last checkpoint are not duplicated
+  CheckpointState ckptState;
+  if (params.resume) {
+    if (!ReadCheckpointState(params.checkpointDir, ckptState)) {
+      std::cerr << "No checkpoint found in " << params.checkpointDir << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cout << "Resuming from the checkpoint taken before iteration " << ckptState.nextEpoch << std::endl;
+    for (auto [file, offset] : {std::make_pair(params.lossOutFile, ckptState.lossOffset),
+                                std::make_pair(params.weightsOutFile, ckptState.weightsOffset),
+                                std::make_pair(params.testLossOutFile, ckptState.testLossOffset)}) {
+      std::error_code ec;
+      auto size = std::filesystem::file_size(file, ec);
+      if (ec || size < static_cast<std::uintmax_t>(offset)) {
+        std::cerr << "Cannot resume: " << file << " is missing or shorter than the " << offset
+                  << " bytes the checkpoint recorded. Resume with the same output file prefix (-w) and"
+                  << " bootstrapping mode (-b) as the original run"
+                  << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      std::filesystem::resize_file(file, offset, ec);
+      if (ec) {
+        std::cerr << "Cannot resume: could not truncate " << file << ": " << ec.message() << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
   }
-  ofsloss << "Time Taken(s), " << "Train Losses" << std::endl;
+  auto outMode = std::ofstream::out | (params.resume ? std::ofstream::app : std::ofstream::trunc);
+  // a sweep writes a loss curve per configuration instead, see sweep.h
+  bool sweepMode = !params.sweepFile.empty();
 
+  std::ofstream ofsloss;
   std::ofstream weightOFS;
-  weightOFS.precision(params.outputPrecision);
-  weightOFS.open(params.weightsOutFile, std::ofstream::out | std::ofstream::trunc);
+  std::ofstream testOFS;
+  if (!sweepMode) {
+    ofsloss.precision(params.outputPrecision);
+    ofsloss.open(params.lossOutFile, outMode);
+    if (!ofsloss.is_open()) {
+      std::cerr << "Could not open file to write train loss to " << params.lossOutFile << std::endl;
+      exit(EXIT_FAILURE);
+    }
 
-  if (!weightOFS.is_open()) {
-    std::cerr << "Couldn't open file to write weights to";
-    exit(EXIT_FAILURE);
-  }
-  weightOFS << "Weights" << std::endl;
+    weightOFS.precision(params.outputPrecision);
+    weightOFS.open(params.weightsOutFile, outMode);
 
-  std::ofstream testOFS;
-  testOFS.precision(params.outputPrecision);
-  testOFS.open(params.testLossOutFile, std::ofstream::out | std::ofstream::trunc);
-  if (!testOFS.is_open()) {
-    std::cerr << "Couldn't open file to write test loss to";
-    exit(EXIT_FAILURE);
+    if (!weightOFS.is_open()) {
+      std::cerr << "Couldn't open file to write weights to";
+      exit(EXIT_FAILURE);
+    }
+
+    testOFS.precision(params.outputPrecision);
+    testOFS.open(params.testLossOutFile, outMode);
+    if (!testOFS.is_open()) {
+      std::cerr << "Couldn't open file to write test loss to";
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (!params.resume && !sweepMode) {
+    ofsloss << "Time Taken(s), " << "Train Losses" << std::endl;
+    weightOFS << "Weights" << std::endl;
+    testOFS << "Test Losses" << std::endl;
   }
-  testOFS << "Test Losses" << std::endl;
 
 
+  /////////////////////////////////////////////////////////////////
+  //Load Plaintext Data
+  //  Done before planning the crypto parameters: the shape of the training set
+  //  decides the depth, the ring dimension and which rotation and bootstrapping keys we need
+  /////////////////////////////////////////////////////////////////
+  Mat NegXt;
+  Mat beta;
+  Mat X;
+  Mat y;
+  Mat testX;
+  Mat testY;
+
+  // With an encrypted dataset bundle the training set only exists in encrypted form:
+  //    only its layout is read here and the test set is the only CSV we parse
+  EncDataset encData;
+  bool loadedBundle = !params.datasetBundleDir.empty() && ReadEncDatasetMetadata(params.datasetBundleDir, encData);
+
+  usint originalNumSamp;
+  usint originalNumFeat;
+  // a bundle fixes the ring dimension and the layout it was encrypted with
+  Parameters planParams = params;
+  if (loadedBundle) {
+    LoadTestData(params, testX, testY);
+    originalNumSamp = encData.numSamples;
+    originalNumFeat = encData.numFeatures;
+    beta = Mat(originalNumFeat, 1);
+    if (params.matVecLayout != "auto" && params.matVecLayout != MatVecLayoutName(encData.layout)) {
+      std::cerr << "Encrypted dataset bundle uses the " << MatVecLayoutName(encData.layout) << " layout, not "
+                << params.matVecLayout << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    planParams.matVecLayout = MatVecLayoutName(encData.layout);
+    uint32_t bundleRingDim = 2 * encData.rowSize * encData.colSize;
+    if (params.ringDimension != 0 && params.ringDimension != bundleRingDim) {
+      std::cerr << "Encrypted dataset bundle was encrypted with ring dimension " << bundleRingDim << ", not "
+                << params.ringDimension << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    planParams.ringDimension = bundleRingDim;
+    if (params.adaptiveSigmoid || params.sigmoidFit == "elsq" || sweepMode) {
+      std::cerr << "-A, -F elsq and -S need the plaintext training set, which is not read when training from a"
+                << " dataset bundle" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  } else {
+    LoadTrainData(params, X, y, testX, testY);
+    originalNumSamp = X.NumRows();     //n_samp
+    originalNumFeat = X.NumCols();  //n_feat (including the intecept column
+  }
+
   /////////////////////////////////////////////////////////
   // Crypto CryptoParams
+  //  planned from the job: see crypto_planner.h
   /////////////////////////////////////////////////////////
   lbcrypto::SecurityLevel securityLevel = lbcrypto::HEStd_128_classic;
 //  lbcrypto::SecurityLevel securityLevel = lbcrypto::HEStd_NotSet;
-  uint32_t numLargeDigits = 0;
   uint32_t maxRelinSkDeg = 1;
 
 #if NATIVEINT == 128
   std::cout << "Running in 128-bit mode" << std::endl;
-  uint32_t firstModSize = 89;
-  uint32_t dcrtBits = 78;
 #else
   std::cout << "Running in 64-bit mode" << std::endl;
-  uint32_t firstModSize = 60;
-  uint32_t dcrtBits = 59;
 #endif
-  uint32_t batchSize = params.ringDimension / 2;
+  std::cout << (params.withBT ? "Using Bootstrapping" : "Using Interactive Methods") << std::endl;
   lbcrypto::ScalingTechnique rsTech = lbcrypto::FIXEDAUTO;
   lbcrypto::KeySwitchTechnique ksTech = lbcrypto::HYBRID;
 
+  // Bootstrapping params here set based on discussion in
+  // https://github.com/openfheorg/openfhe-development/blob/main/src/pke/examples/advanced-ckks-bootstrapping.cpp
+  usint sigmoidDegree = (params.sigmoidDegree == 0) ? CHEBYSHEV_ESTIMATION_DEGREE : params.sigmoidDegree;
+  // with -A the dataset is encrypted for the lowest degree the sigmoid schedule starts at
+  usint datasetSigmoidDegree = sigmoidDegree;
+  if (params.adaptiveSigmoid && !SigmoidScheduleDegrees(sigmoidDegree).empty()) {
+    datasetSigmoidDegree = SigmoidScheduleDegrees(sigmoidDegree).front();
+  }
+  // a sweep plans the depth for its deepest sigmoid and the dataset levels for its shallowest
+  std::vector<SweepConfig> sweepConfigs;
+  if (sweepMode) {
+    SweepConfig defaults;
+    defaults.lrGamma = LR_GAMMA;
+    defaults.lrEta = LR_ETA;
+    defaults.rangeStart = CHEBYSHEV_RANGE_ESTIMATION_START;
+    defaults.rangeEnd = CHEBYSHEV_RANGE_ESTIMATION_END;
+    defaults.degree = sigmoidDegree;
+    sweepConfigs = ReadSweepConfigs(params.sweepFile, defaults);
+    sigmoidDegree = 0;
+    datasetSigmoidDegree = sweepConfigs.front().degree;
+    for (auto &config : sweepConfigs) {
+      sigmoidDegree = std::max(sigmoidDegree, config.degree);
+      datasetSigmoidDegree = std::min(datasetSigmoidDegree, config.degree);
+    }
+    std::cout << "Sweeping " << sweepConfigs.size() << " configurations from " << params.sweepFile << std::endl;
+  }
+  CryptoPlan plan = PlanCryptoParams(planParams, originalNumSamp, originalNumFeat, sigmoidDegree,
+                                     planParams.ringDimension, datasetSigmoidDegree);
+  PrintCryptoPlan(plan);
+
   CryptoParams parameters;
-  std::vector<uint32_t> levelBudget;
+  std::vector<uint32_t> levelBudget = plan.levelBudget;
   std::vector<uint32_t> bsgsDim = {0, 0};
-  uint32_t multDepth;
-
-  if (params.withBT) {
-    std::cout << "Using Bootstrapping" << std::endl;
-    // Params here set based on discussion in
-    // https://github.com/openfheorg/openfhe-development/blob/main/src/pke/examples/advanced-ckks-bootstrapping.cpp
-    lbcrypto::SecretKeyDist skDist = lbcrypto::UNIFORM_TERNARY;
-    // linear transform using 1 level is good for CKKS bootstrapping as the number of features is small (10)
-    levelBudget = {2, 2};
-    uint32_t levelsBeforeBootstrap = 14;
-    uint32_t approxBootstrapDepth = 8;
-
-#if NATIVEINT == 64
-    // Add an extra level based on empirical run results. We've encountered an error of
-    //"DCRTPolyImpl's towers are not initialized" and this addition solves that.
-    levelsBeforeBootstrap++;
-#endif
-
-    multDepth = levelsBeforeBootstrap + lbcrypto::FHECKKSRNS::GetBootstrapDepth(
-        approxBootstrapDepth, levelBudget, skDist
-    );
-
-    std::cout << "*********************************************" << std::endl;
-    std::cout << "Bootstrapping Crypto Params" << std::endl;
-    std::cout << "\tDiscrete key used: " << skDist << std::endl;
-    std::cout << "\tApprox Bootstrap depth: " << approxBootstrapDepth << std::endl;
-    std::cout << "\tLevels before bootstrap: " << levelsBeforeBootstrap << std::endl;
-
-    std::cout << "\tFinal Bootstrap Depth:  " << multDepth << std::endl;
-    parameters.SetSecretKeyDist(skDist);
-  } else {
-    std::cout << "Using Interactive Methods" << std::endl;
-    // Unpacking the two ciphertexts
-
-    // EncLogRegCalculateGradient consumes 12 levels:
-    // MatrixVectorProductRow takes 2 levels,
-    // EvalLogistic for deg = 128 takes 9 levels
-    // and then MatrixVectorProductCol takes 1 level
-
-    // then 2 more levels are used after logreg iteration
-
-    // Used to be 12 based on above, but in the case where we pack the
-    // weights nto a single ciphertext we need to do extra mults
-    // NOTE: Recreating the theta and phi from the single ciphertext
-    //      + 1 multiplication and 1 rotation
-    // NOTE: Joining theta and phi into a single ciphertext
-    //      + 1 multiplication and 1 addition
-    multDepth = 13;
-  }
 
   /////////////////////////////////////////////////////////
   // Set crypto params and create context
   /////////////////////////////////////////////////////////
-  parameters.SetMultiplicativeDepth(multDepth);
-  parameters.SetScalingModSize(dcrtBits);
-  parameters.SetBatchSize(batchSize);
+  ApplyCryptoPlan(plan, parameters);
   parameters.SetSecurityLevel(securityLevel);
-  parameters.SetRingDim(params.ringDimension);
   parameters.SetScalingTechnique(rsTech);
   parameters.SetKeySwitchTechnique(ksTech);
-  parameters.SetNumLargeDigits(numLargeDigits);
-  parameters.SetFirstModSize(firstModSize);
   parameters.SetMaxRelinSkDeg(maxRelinSkDeg);
 
-  CC cc;
-  cc = GenCryptoContext(parameters);
+  usint numSlots = plan.ringDim / 2;
+  if (!loadedBundle) {
+    populateData(params, numSlots, NegXt, beta, X, y, LR_GAMMA * (1 + LR_ETA));
+  }
 
-  // Enable the features that you wish to use.
-  cc->Enable(lbcrypto::PKE);
-  cc->Enable(lbcrypto::LEVELEDSHE);
-  cc->Enable(lbcrypto::ADVANCEDSHE);
+  auto dims = ComputePaddedDimensions(originalNumSamp, originalNumFeat, numSlots);
+  usint rowSize = dims.second;
+  int signedRowSize = (int) rowSize;
 
-  if (!cc) {
-    std::cout << "Error generating CKKS context... " << std::endl;
-    exit(EXIT_FAILURE);
+  // Row-major packing or diagonals, see "Diagonal Matrix-Vector Products" in the README. A bundle
+  //    keeps the layout it was encrypted with
+  MatVecLayout layout = plan.layout;
+  for (auto candidate : {MatVecLayout::ROW_MAJOR, MatVecLayout::DIAGONAL}) {
+    auto cost = EstimateMatVecCost(candidate, originalNumSamp, rowSize, numSlots, params.hoistRadix);
+    std::cout << "Layout " << MatVecLayoutName(candidate) << ": " << cost.shards << " shard(s), "
+              << cost.ciphertexts << " dataset ciphertexts, ~" << cost.keySwitches << " key switches per iteration"
+              << std::endl;
+  }
+  std::cout << "Using the " << MatVecLayoutName(layout) << " layout" << std::endl;
+
+  usint shardCapacity = ShardCapacity(layout, rowSize, numSlots);
+  double negXtScale = ComputeNegXtScale(params, originalNumSamp, shardCapacity, LR_GAMMA * (1 + LR_ETA));
+  std::cout << "Scaling -X' by " << negXtScale << " ((1 + eta) lrGamma / rows per batch)" << std::endl;
+  double negXtTailScale = ComputeTailShardScale(params, originalNumSamp, shardCapacity);
+  if (negXtTailScale != 1.0) {
+    // with -X the labels carry the scale, but the sigmoid they are subtracted from is shared by every shard
+    if (params.singleX) {
+      usint shardRows = ResolveShardRows(params, shardCapacity);
+      std::cerr << "The last shard holds " << originalNumSamp % shardRows << " of " << shardRows
+                << " rows: with -X and -s the number of samples must be a multiple of the rows per shard (-c)"
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cout << "Scaling the partial last shard of -X' by another " << negXtTailScale << std::endl;
+  }
+  if (loadedBundle) {
+    if (std::abs(encData.negXtScale - negXtScale) > 1e-9 * std::abs(negXtScale) ||
+        std::abs(encData.negXtTailScale - negXtTailScale) > 1e-9 * negXtTailScale ||
+        (params.shardRows != 0 && params.shardRows != encData.shardRows) ||
+        (params.singleX && !encData.singleX)) {
+      std::cerr << "Encrypted dataset bundle was built with NegXt scale " << encData.negXtScale
+                << " and " << encData.shardRows << " rows per shard"
+                << (encData.singleX ? " (single X)" : " (X and NegXt)") << ", which does not match this run" << std::endl;
+      exit(EXIT_FAILURE);
+    }
   }
-  std::cout << "Generating keys" << std::endl;
-  KeyPair keys = cc->KeyGen();
-  std::cout << "\tMult keys" << std::endl;
-  cc->EvalMultKeyGen(keys.secretKey);
-  std::cout << "\tEvalSum keys" << std::endl;
-  cc->EvalSumKeyGen(keys.secretKey);
 
-  usint numSlots = cc->GetEncodingParams()->GetBatchSize();
+  // The dataset is encrypted at the levels it is consumed at instead of at the top of the chain
+  DatasetLevels datasetLevels = plan.datasetLevels;
+  std::cout << "Dataset levels: X " << datasetLevels.x << ", NegXt " << datasetLevels.negXt
+            << ", y " << datasetLevels.labels << std::endl;
+  if (loadedBundle) {
+    // a shallower bundle only wastes towers, a deeper one would drag the weights down with it
+    if (encData.levels.x > datasetLevels.x || encData.levels.negXt > datasetLevels.negXt ||
+        encData.levels.labels > datasetLevels.labels) {
+      std::cerr << "Encrypted dataset bundle was encrypted at levels deeper than this run consumes them at"
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
 
   /////////////////////////////////////////////////////////////////
-  //Load Plaintext Data
+  // Optimization: set the number of slots for sparse bootstrap
   /////////////////////////////////////////////////////////////////
-  Mat NegXt;
-  Mat beta;
-  Mat X;
-  Mat y;
-  Mat testX;
-  Mat testY;
 
-  PT ptExtractThetaMask;
-  PT ptExtractPhiMask;
+  auto numSlotsBoot = plan.numSlotsBoot;
 
-  populateData(params, cc, keys, NegXt,
-               beta, X, y, testX, testY,
-               ptExtractThetaMask, ptExtractPhiMask, LR_GAMMA
-  );
+  /////////////////////////////////////////////////////////////////
+  // Create the context and keys, or reload them from the key store
+  /////////////////////////////////////////////////////////////////
+  CC cc;
+  KeyPair keys;
+  MatKeys evalSumRowKeys;
+  MatKeys evalSumColKeys;
+  // automorphism indices EvalBootstrapKeyGen added, the KeyProvider's bootstrapping group
+  std::vector<usint> bootstrapKeyIndices;
+
+  std::unique_ptr<KeyStore> keyStore;
+  if (!params.keyStoreDir.empty()) {
+    keyStore = std::make_unique<KeyStore>(
+        params.keyStoreDir, CryptoFingerprint(parameters, params.withBT, levelBudget, rowSize, numSlotsBoot, params.hoistRadix,
+                                               layout)
+    );
+  }
+
+  TimeVar tSetup;
+  TIC(tSetup);
+  bool loadedFromStore = keyStore && keyStore->Exists();
+  if (loadedFromStore) {
+    keyStore->Load(cc, keys, evalSumRowKeys, evalSumColKeys, bootstrapKeyIndices);
+    std::cout << "Loaded context and keys in " << TOC(tSetup) / 1000.0 << " s" << std::endl;
+  } else {
+    cc = GenCryptoContext(parameters);
+
+    // Enable the features that you wish to use.
+    cc->Enable(lbcrypto::PKE);
+    cc->Enable(lbcrypto::LEVELEDSHE);
+    cc->Enable(lbcrypto::ADVANCEDSHE);
+    if (params.withBT) {
+      cc->Enable(lbcrypto::FHE);
+    }
 
-  usint originalNumSamp = X.size();     //n_samp
+    if (!cc) {
+      std::cout << "Error generating CKKS context... " << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cout << "Generating keys" << std::endl;
+    keys = cc->KeyGen();
+    std::cout << "\tMult keys" << std::endl;
+    cc->EvalMultKeyGen(keys.secretKey);
+
+    // The bootstrapping keys go first: the keys they add to the empty automorphism key map are
+    //    exactly the bootstrapping group of the KeyProvider
+    if (params.withBT) {
+      std::cout << "\tBootstrapping keys" << std::endl;
+      cc->EvalBootstrapSetup(levelBudget, bsgsDim, numSlotsBoot);
+      cc->EvalBootstrapKeyGen(keys.secretKey, numSlotsBoot);
+      for (auto &indexKey : cc->GetEvalAutomorphismKeyMap(keys.secretKey->GetKeyTag())) {
+        bootstrapKeyIndices.push_back(indexKey.first);
+      }
+    }
 
-  usint originalNumFeat = X[0].size();  //n_feat (including the intecept column
-  auto dims = ComputePaddedDimensions(originalNumSamp, originalNumFeat, numSlots);
-  usint rowSize = dims.second;
-  int signedRowSize = (int) rowSize;
+    // only the rotations this run performs, see "Minimal Rotation Keys" in the README
+    auto &rotationKeys = plan.rotationKeys;
+    TimeVar tRotationKeys;
+    TIC(tRotationKeys);
+    std::cout << "\tEvalRotate keys" << std::endl;
+    cc->EvalRotateKeyGen(keys.secretKey, rotationKeys.rotations);
+    if (rotationKeys.evalSumKeys) {
+      std::cout << "\tEvalSum keys" << std::endl;
+      cc->EvalSumKeyGen(keys.secretKey);
+      evalSumRowKeys = cc->EvalSumRowsKeyGen(keys.secretKey, nullptr, rowSize);
+      evalSumColKeys = cc->EvalSumColsKeyGen(keys.secretKey);
+    } else {
+      // left empty, the key store still saves them
+      evalSumRowKeys = std::make_shared<std::map<usint, lbcrypto::EvalKey<lbcrypto::DCRTPoly>>>();
+      evalSumColKeys = std::make_shared<std::map<usint, lbcrypto::EvalKey<lbcrypto::DCRTPoly>>>();
+    }
+    double rotationKeyMs = TOC(tRotationKeys);
+    usint numBootstrapKeys = bootstrapKeyIndices.size();
+    PrintRotationKeyReport(plan, rotationKeyMs, numBootstrapKeys);
+    std::cout << "Generated context and keys in " << TOC(tSetup) / 1000.0 << " s" << std::endl;
+
+    if (keyStore) {
+      keyStore->Save(cc, keys, evalSumRowKeys, evalSumColKeys, bootstrapKeyIndices);
+    }
+  }
+
+  if (params.withBT && loadedFromStore) {
+    // The bootstrapping keys were loaded with the other automorphism keys, but the linear
+    //    transform precomputations are not part of the serialized context
+    cc->EvalBootstrapSetup(levelBudget, bsgsDim, numSlotsBoot);
+  }
+
+  // With -M the automorphism keys live on disk and are loaded when an iteration or a bootstrap
+  //    needs them, see "Key Provider" in the README
+  std::unique_ptr<KeyProvider> keyProvider;
+  if (params.keyCacheMB > 0) {
+    std::string keyTag = keys.secretKey->GetKeyTag();
+    std::set<usint> bootstrapGroup(bootstrapKeyIndices.begin(), bootstrapKeyIndices.end());
+    // every key bootstrapping did not add, and the planned rotations it shares with bootstrapping
+    std::vector<int32_t> iterationRotations = plan.rotationKeys.rotations;
+    if (plan.rotationKeys.evalSumKeys) {
+      for (usint i = 1; i < numSlots; i *= 2) {
+        iterationRotations.push_back(i);
+      }
+    }
+    std::set<usint> iterationGroup;
+    auto &keyMap = cc->GetEvalAutomorphismKeyMap(keyTag);
+    for (auto index : RotationAutomorphismIndices(iterationRotations, cc->GetCyclotomicOrder())) {
+      if (keyMap.count(index) > 0) {
+        iterationGroup.insert(index);
+      }
+    }
+    for (auto &indexKey : keyMap) {
+      if (bootstrapGroup.count(indexKey.first) == 0) {
+        iterationGroup.insert(indexKey.first);
+      }
+    }
+
+    // kept next to the key store, which holds the same keys, or removed at exit
+    std::string keyDir = keyStore ? (std::filesystem::path(keyStore->GetDir()) / "lazy_keys").string()
+        : (std::filesystem::temp_directory_path() /
+            ("lr_nag_keys_" + std::to_string(std::hash<std::string>{}(keyTag)))).string();
+    keyProvider = std::make_unique<KeyProvider>(keyDir, keyTag, params.keyCacheMB, loadedFromStore, !keyStore);
+    keyProvider->AddGroup(ITERATION_KEY_GROUP, std::vector<usint>(iterationGroup.begin(), iterationGroup.end()));
+    keyProvider->AddGroup(BOOTSTRAP_KEY_GROUP, bootstrapKeyIndices);
+    std::cout << "Key provider: " << keyProvider->NumKeys() << " keys (" << keyProvider->TotalMB() << " MB) in "
+              << keyDir << ", " << iterationGroup.size() << " per iteration, " << bootstrapGroup.size()
+              << " per bootstrap, at most " << params.keyCacheMB << " MB resident" << std::endl;
+  }
+
+  PT ptExtractThetaMask;
+  PT ptExtractPhiMask;
+  MakeWeightMasks(cc, rowSize, ptExtractThetaMask, ptExtractPhiMask);
+  PT ptRowStartMask;
+  MakeRowStartMask(cc, rowSize, ptRowStartMask);
+  PT ptWeightsFactor;
+  PT ptRotatedFactor;
+  PT ptFirstGradientFactor;
+  MakeNagStepFactors(cc, rowSize, LR_ETA, ptWeightsFactor, ptRotatedFactor, ptFirstGradientFactor);
 
-  MatKeys evalSumRowKeys = cc->EvalSumRowsKeyGen(keys.secretKey, nullptr, rowSize);
-  MatKeys evalSumColKeys = cc->EvalSumColsKeyGen(keys.secretKey);
   /////////////////////////////////////////////////////////////////
   //Encrypt Data
   /////////////////////////////////////////////////////////////////
 
-  CT ctWeights = collateOneDMats2CtVRC(cc, beta, beta, rowSize, numSlots, keys);
-  // returns negative X' matrix n_samp x n_features and initializes beta
-  auto ctNegXt = Mat2CtMRM(cc, NegXt, rowSize, numSlots, keys);
+  // theta in the even blocks, (1 + eta) phi in the odd ones (see PackedNagStep)
+  Mat scaledBeta(beta.NumRows(), beta.NumCols());
+  for (usint i = 0; i < beta.NumRows(); i++) {
+    scaledBeta[i][0] = (1 + LR_ETA) * beta[i][0];
+  }
+  CT ctWeights = collateOneDMats2CtVRC(cc, beta, scaledBeta, rowSize, numSlots, keys);
 
+  // X, NegXt and y are split row-wise into as many ciphertexts as needed to hold every sample.
+  //    X and NegXt use MAT_ROW_MAJOR (NegXt is -X being transposed by packing), y uses VEC_COL_CLONED
+  //    With -X NegXt is not encrypted and y carries its scale instead
   ///note these functions WILL zero pad out the matricies
-  auto ctX = Mat2CtMRM(cc, X, rowSize, numSlots, keys); //verified ok
-  // using mcm because NegXt is -X being transposed by packing.
-  CT ctyVCC = OneDMat2CtVCC(cc, y, rowSize, numSlots, keys);
+  if (loadedBundle) {
+    LoadEncDataset(params.datasetBundleDir, cc, keys, encData);
+    std::cout << "Loaded " << encData.numSamples << " encrypted samples in " << encData.NumShards()
+              << " shard(s) of " << encData.shardRows << " rows" << std::endl;
+  } else {
+    encData = EncryptDataset(cc, X, NegXt, y, rowSize, numSlots, keys, params.shardRows, params.encryptThreads,
+                             params.singleX, negXtScale, datasetLevels, layout);
+    // populateData already scaled the last shard's rows of NegXt
+    encData.negXtTailScale = negXtTailScale;
+    std::cout << "Encrypted " << encData.numSamples << " samples into " << encData.NumShards()
+              << " shard(s) of " << encData.shardRows << " rows" << std::endl;
+    if (!params.datasetBundleDir.empty()) {
+      SaveEncDataset(params.datasetBundleDir, cc, encData);
+    }
+  }
+
+  if (sweepMode) {
+    auto results = RunSweep(cc, keys, evalSumRowKeys, evalSumColKeys, encData, X, y, testX, testY, plan, params,
+                            sweepConfigs, LR_GAMMA * (1 + LR_ETA));
+    WriteSweepSummary(results, params);
+    return EXIT_SUCCESS;
+  }
+
+  // The sigmoid coefficients are fitted once here instead of by EvalLogistic in every iteration.
+  //    With a single X the label scale is folded into them (see EvalResidual). The logits of a
+  //    plaintext run estimate where the sigmoid is evaluated: elsq fits to them, the others report
+  //    their error over them
+  SigmoidFit sigmoidFit;
+  ParseSigmoidFit(params.sigmoidFit, sigmoidFit);
+  std::vector<double> logitSamples;
+  if (!X.Empty()) {
+    logitSamples = SampleNagLogits(X, y, params.numIters, LR_GAMMA, LR_ETA);
+  }
+  SigmoidSchedule sigmoids(sigmoidFit, CHEBYSHEV_RANGE_ESTIMATION_START, CHEBYSHEV_RANGE_ESTIMATION_END,
+                           sigmoidDegree, encData.LabelScale(), logitSamples, params.adaptiveSigmoid);
+  double maxStageError = 0;
+  for (auto &stage : sigmoids.Stages()) {
+    std::cout << "Sigmoid: " << SigmoidFitName(sigmoidFit) << " fit of degree " << stage.Degree() << " over ["
+              << stage.RangeStart() << ", " << stage.RangeEnd() << "], depth " << stage.Depth()
+              << ", max error " << stage.Error().maxError << ", mean error " << stage.Error().meanError
+              << ", mean error over the training logits " << stage.Error().sampleMeanError << std::endl;
+    maxStageError = std::max(maxStageError, stage.Error().maxError);
+  }
+  // -A picks the stage from a bound on the logits of each iteration: interactively from the decrypted
+  //    weights, with bootstrapping (no decryption) from the growth NAG allows the weights
+  std::vector<double> logitBounds;
+  if (params.adaptiveSigmoid && params.withBT) {
+    logitBounds = NagLogitBounds(params.numIters, LR_GAMMA, LR_ETA, MaxRowNorm(X), 1 + maxStageError);
+  }
+
+  // Mini-batch mode: each iteration consumes params.batchShards shards instead of the whole dataset
+  std::unique_ptr<MiniBatchSchedule> batchSchedule;
+  if (params.batchShards > 0) {
+    batchSchedule = std::make_unique<MiniBatchSchedule>(encData.NumShards(), params.batchShards, params.shuffleBatches);
+  }
+  std::vector<usint> batchShardIndices;  // empty is full batch
+
+  usint startEpoch = 0;
+  double totalTime = 0;
+  if (params.resume) {
+    if (ckptState.weightsPacking != NAG_WEIGHTS_PACKING) {
+      std::cerr << "Checkpoint holds weights packed as " << ckptState.weightsPacking << ", this run packs them as "
+                << NAG_WEIGHTS_PACKING << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    ctWeights = LoadCheckpointWeights(params.checkpointDir, ckptState, keys);
+    startEpoch = ckptState.nextEpoch;
+    totalTime = ckptState.totalTime;
+    if (batchSchedule) {
+      batchSchedule->SetState(ckptState.batchScheduleState);
+    }
+  }
+  std::unique_ptr<CheckpointWriter> ckptWriter;
+  if (!params.checkpointDir.empty()) {
+    ckptWriter = std::make_unique<CheckpointWriter>(params.checkpointDir,
+                                                    params.resume ? ckptState.weightsFile : "");
+  }
   /////////////////////////////////////////////////////////////////
   //Tracking and debugging
   /////////////////////////////////////////////////////////////////
   PT ptTheta; //plaintext for the resulting beta output
   CT ctGradient;
-  double totalTime = 0;
   Vec final_b_vec;
   Mat final_b;
 
   TimeVar t;
-  /////////////////////////////////////////////////////////////////
-  // Optimization: set the number of slots for sparse bootstrap
-  /////////////////////////////////////////////////////////////////
-
-  auto numFeaturesEnc = NextPow2(originalNumFeat);
-  auto numSlotsBoot = numFeaturesEnc * 8;
-  if (params.withBT) {
-    cc->Enable(lbcrypto::FHE);
-    cc->EvalBootstrapSetup(levelBudget, bsgsDim, numSlotsBoot);
-    cc->EvalBootstrapKeyGen(keys.secretKey, numSlotsBoot);
-  }
 
   /////////////////////////////////////////////////////////////////
   // Logistic regression training loop on encrypted data
   auto mode = (params.withBT) ? "Bootstrap " : "Interactive ";
+  auto refreshName = (params.withBT) ? "bootstrap" : "re-encryption";
+  // the weights are refreshed only when the next iteration would not fit, see BootstrapScheduler
+  BootstrapScheduler refreshSchedule(plan.iteration.Total(), plan.weightsLevel, plan.maxWeightsLevel);
+  // -E picks single or double bootstrapping for each bootstrap from a probe of its error
+  std::unique_ptr<PrecisionMonitor> precisionMonitor;
+#if NATIVEINT == 128
+  if (params.targetBootstrapError > 0) {
+    std::cout << "-E is ignored: 128-bit builds have no double bootstrapping" << std::endl;
+  }
+#else
+  if (params.targetBootstrapError > 0) {
+    precisionMonitor = std::make_unique<PrecisionMonitor>(keys, params.targetBootstrapError, params.btPrecision,
+                                                          2 * rowSize);
+  }
+#endif
+  // the iteration depth without the sigmoid, which depends on the stage
+  usint iterationBaseDepth = plan.iteration.Total() - plan.iteration.sigmoid;
   std::cout << std::endl;
-  for (usint epochI = 0; epochI < params.numIters; epochI++) {
+  for (usint epochI = startEpoch; epochI < params.numIters; epochI++) {
     TIC(t);
     std::cout << mode << "Iteration: " << epochI
               << " ******************************************************************"
               << std::endl;
     auto epochInferenceStart = std::chrono::high_resolution_clock::now();
-    if ((params.withBT) && epochI > 0) {
+    double logitBound = 0;
+    if (params.adaptiveSigmoid && params.withBT) {
+      logitBound = logitBounds[epochI];
+    } else if (params.adaptiveSigmoid) {
+      // the key holder decrypts the weights for the re-encryption anyway, theta is the first block
+      PT ptWeights;
+      cc->Decrypt(keys.secretKey, ctWeights, &ptWeights);
+      logitBound = MaxAbsLogit(X, ptWeights->GetRealPackedValue());
+    }
+    const SigmoidEvaluator &sigmoid = params.adaptiveSigmoid ? sigmoids.Select(logitBound) : sigmoids.Final();
+    usint iterationDepth = iterationBaseDepth + sigmoid.Depth();
+    if (params.adaptiveSigmoid) {
+      std::cout << "\tLogits within +-" << logitBound << ": degree " << sigmoid.Degree() << " sigmoid over ["
+                << sigmoid.RangeStart() << ", " << sigmoid.RangeEnd() << "]" << std::endl;
+    }
+
+    usint weightsLevel = ctWeights->GetLevel();
+    bool refresh = refreshSchedule.RefreshBeforeIteration(weightsLevel, iterationDepth);
+    std::cout << "\tWeights at level " << weightsLevel << ", the iteration ends at level "
+              << refreshSchedule.EndLevel(weightsLevel, iterationDepth) << " of " << refreshSchedule.MaxLevel() << ": "
+              << (refresh ? "running the " : "skipping the ") << refreshName << std::endl;
+    if (refresh && params.withBT) {
+      if (keyProvider) {
+        keyProvider->Require(BOOTSTRAP_KEY_GROUP);
+      }
       ctWeights->SetSlots(numSlotsBoot);
 #if NATIVEINT == 128
       ctWeights = cc->EvalBootstrap(ctWeights);
@@ -347,7 +650,9 @@ int main(int argc, char *argv[]) {
       // If we are in the 64-bit case, we may want to run bootstrapping twice
       //    As this will increase our precision, which will make our results
       //    more in-line with the 128-bit version
-      if (params.btPrecision > 0){
+      if (precisionMonitor) {
+        ctWeights = precisionMonitor->Bootstrap(cc, ctWeights);
+      } else if (params.btPrecision > 0){
         std::cout << "Running double-bootstrapping at: " << params.btPrecision << " precision" << std::endl;
         ctWeights = cc->EvalBootstrap(ctWeights, 2, params.btPrecision);
       } else {
@@ -355,39 +660,28 @@ int main(int argc, char *argv[]) {
       }
 #endif
       OPENFHE_DEBUGEXP(ctWeights->GetLevel());
-    } else {
+    } else if (refresh) {
       OPENFHE_DEBUGEXP(ReturnDepth(ctWeights));
       ReEncrypt(cc, ctWeights, keys);
       OPENFHE_DEBUGEXP(ReturnDepth(ctWeights));
     }
 
     /////////////////////////////////////////////////////////////////
-    // Extract the weights
-    //  1) mask out the phi to get just Theta
-    //  2) mask
+    // Read theta from the packed weights
+    //  1) rotate the weights by rowSize, which swaps the theta and phi blocks
+    //  2) take the theta blocks of both
     /////////////////////////////////////////////////////////////////
-    CT _ctTheta = cc->EvalMult(ctWeights, ptExtractThetaMask);
-    // _ctTheta
-    //      - numFeaturesEnc of 0s, numFeaturesEnc of thetas repeating to fill in the entire CT
-    // | 0, 0, ..., 0, theta_0, theta_1, ..., theta_15, 0,| (repeated)
-    CT ctTheta = cc->EvalAdd(
-        cc->EvalRotate(_ctTheta, signedRowSize),  // | 0, theta, 0, theta ...|
-        _ctTheta);
+    // ctWeights
+    // | theta_0, ..., theta_15, (1+eta) phi_0, ..., (1+eta) phi_15, theta_0, ...|
     // ctTheta
     // | theta_0, theta_1, ..., theta_15, theta_0, theta_1, ..., theta_15|
+    if (keyProvider) {
+      keyProvider->Require(ITERATION_KEY_GROUP);
+    }
+    CT ctWeightsRotated = cc->EvalRotate(ctWeights, signedRowSize);
+    CT ctTheta = ThetaFromPackedWeights(cc, ctWeights, ctWeightsRotated, ptExtractThetaMask, ptExtractPhiMask);
     OPENFHE_DEBUGEXP(ctTheta);
 
-    CT _ctPhi = cc->EvalMult(ctWeights, ptExtractPhiMask); // | 0, phi, 0, phi, ...|
-    // _ctPhi
-    //      - numFeaturesEnc of phis, numFeaturesEnc of 0s repeating to fill in the entire CT
-    // | phi_0, phi_1, ..., phi_15, 0, 0, ..., 0|
-    CT ctPhi = cc->EvalAdd(
-        cc->EvalRotate(_ctPhi, -signedRowSize),
-        _ctPhi
-    );
-    // ctPhi
-    // | phi_0, phi_1, ..., phi_15, phi_0, phi_1, ..., phi_15|
-
 #ifdef ENABLE_DEBUG
     OPENFHE_DEBUG("Decrypting the ciphertexts to inspect the values");
     PT ptThetaDBG;
@@ -399,7 +693,7 @@ int main(int argc, char *argv[]) {
     }
 
     PT ptPhiDBG;
-    cc->Decrypt(ctTheta, keys.secretKey, &ptPhiDBG);
+    cc->Decrypt(ctWeights, keys.secretKey, &ptPhiDBG);
     ptPhiDBG->SetLength(signedRowSize * 4);
     OPENFHE_DEBUG(ptPhiDBG);
     for (auto &v : ptPhiDBG->GetCKKSPackedValue()) {
@@ -412,13 +706,15 @@ int main(int argc, char *argv[]) {
     // and https://jlmelville.github.io/mize/nesterov.html
     /////////////////////////////////////////////////////////////////
 
-    EncLogRegCalculateGradient(cc, ctX, ctNegXt, ctyVCC, ctTheta, ctGradient,
-                               rowSize, evalSumRowKeys, evalSumColKeys, keys,
+    if (batchSchedule) {
+      batchShardIndices = batchSchedule->NextBatch();
+      SimplePrintVec("\tMini-batch shards: ", batchShardIndices);
+    }
+    EncLogRegCalculateGradient(cc, encData, ctTheta, ctGradient,
+                               evalSumRowKeys, evalSumColKeys, ptRowStartMask, keys, sigmoid, batchShardIndices,
                                false,
-                               CHEBYSHEV_RANGE_ESTIMATION_START,
-                               CHEBYSHEV_RANGE_ESTIMATION_END,
-                               CHEBYSHEV_ESTIMATION_DEGREE,
-                               DEBUG_PLAINTEXT_LENGTH
+                               DEBUG_PLAINTEXT_LENGTH,
+                               params.hoistRadix
     );
 #ifdef ENABLE_DEBUG
     PT ptGrad;
@@ -429,34 +725,20 @@ int main(int argc, char *argv[]) {
     /////////////////////////////////////////////////////////////////
     //Note: Formulation of NAG update based on
     // and https://jlmelville.github.io/mize/nesterov.html
+    //  written as one linear map of the packed weights, which stay packed
+    //  (ctGradient is already scaled by 1 + eta through -X')
     /////////////////////////////////////////////////////////////////
-
-    auto ctPhiPrime = cc->EvalSub(
-        ctTheta,
-        ctGradient
-    );
-
-    if (epochI == 0) {
-      ctTheta = ctPhiPrime;
-    } else {
-      ctTheta = cc->EvalAdd(
-          ctPhiPrime,
-          cc->EvalMult(
-              LR_ETA,
-              cc->EvalSub(ctPhiPrime, ctPhi)
-          )
-      );
-    }
-    // Step 11
-    ctPhi = ctPhiPrime;
+    ctWeights = PackedNagStep(cc, ctWeights, ctWeightsRotated, ctGradient,
+                              ptWeightsFactor, ptRotatedFactor, ptFirstGradientFactor, epochI == 0);
     if (DEBUG) {
-      cc->Decrypt(keys.secretKey, ctTheta, &ptTheta);
+      // the first block holds theta
+      cc->Decrypt(keys.secretKey, ctWeights, &ptTheta);
 
       final_b_vec = ptTheta->GetRealPackedValue();
 
       final_b_vec.resize(originalNumFeat);
 
-      final_b = Mat(originalNumFeat, Vec(1, 0.0));
+      final_b = Mat(originalNumFeat, 1);
       //copy values into final_b matrix
       std::cout << "\tNew weights: ";
       for (auto copyI = 0U; copyI < originalNumFeat; copyI++) {
@@ -465,7 +747,8 @@ int main(int argc, char *argv[]) {
       }
       std::cout << std::endl;
 
-      auto loss = ComputeLoss(final_b, X, y);
+      // the plaintext training set is not available when training from a dataset bundle
+      double loss = X.Empty() ? std::nan("") : ComputeLoss(final_b, X, y);
       /////////////////////////////////////////////////////////////////
       //Saving and logging information
       /////////////////////////////////////////////////////////////////
@@ -487,27 +770,40 @@ int main(int argc, char *argv[]) {
 
         weightOFS << epochI << ",";
         OPENFHE_DEBUG("Writing weights to: " + params.weightsOutFile);
-        for (auto &singletonWeight : final_b) {
-          weightOFS << singletonWeight[0] << ",";
+        for (usint weightI = 0; weightI < final_b.NumRows(); weightI++) {
+          weightOFS << final_b(weightI, 0) << ",";
         }
         weightOFS << std::endl;
         /////////////////////////////////////////////////////////////////
         // Writing the Test Loss
         /////////////////////////////////////////////////////////////////
         OPENFHE_DEBUG("Writing test loss to: " + params.testLossOutFile);
-        auto testLoss = ComputeLoss(final_b, testX, testY);
-        std::cout << "\tTest Loss: " << testLoss << std::endl;
-        testOFS << epochI << ", " << testLoss << std::endl;
+        auto testStats = ComputeLossAndAccuracy(final_b, testX, testY);
+        std::cout << "\tTest Loss: " << testStats.loss << "\tTest Accuracy: " << testStats.accuracy << std::endl;
+        testOFS << epochI << ", " << testStats.loss << std::endl;
       }
     }
 
     /////////////////////////////////////////////////////////////////
-    // Packing the two ciphertexts back
+    // Checkpointing: the weights are cloned because bootstrapping changes ctWeights in place
     /////////////////////////////////////////////////////////////////
-    OPENFHE_DEBUG("Repacking the ciphertexts");
-    ctTheta = cc->EvalMult(ctTheta, ptExtractThetaMask);  // | theta, 0, theta, 0|
-    ctPhi = cc->EvalMult(ctPhi, ptExtractPhiMask);  //| 0, phi, 0, phi|
-    ctWeights = cc->EvalAdd(ctTheta, ctPhi);
+    if (ckptWriter && ((epochI + 1) % params.checkpointEvery == 0 || epochI + 1 == params.numIters)) {
+      ofsloss.flush();
+      weightOFS.flush();
+      testOFS.flush();
+      CheckpointState state;
+      state.nextEpoch = epochI + 1;
+      state.totalTime = totalTime;
+      state.weightsPacking = NAG_WEIGHTS_PACKING;
+      // file sizes rather than tellp(): in append mode the put position is only valid after a write
+      state.lossOffset = std::filesystem::file_size(params.lossOutFile);
+      state.weightsOffset = std::filesystem::file_size(params.weightsOutFile);
+      state.testLossOffset = std::filesystem::file_size(params.testLossOutFile);
+      if (batchSchedule) {
+        state.batchScheduleState = batchSchedule->GetState();
+      }
+      ckptWriter->Submit(ctWeights->Clone(), state);
+    }
 
     auto epochInferenceEnd = std::chrono::high_resolution_clock::now();
     auto inferenceDuration = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -515,9 +811,22 @@ int main(int argc, char *argv[]) {
     );
     std::cout << "\t***Iteration: " << epochI << "\tInference time: " << inferenceDuration.count() << " seconds" << std::endl;
   }
+  if (ckptWriter) {
+    ckptWriter->Wait();
+  }
   ofsloss.close();
   weightOFS.close();
   testOFS.close();
   std::cout << "Total Time for training " << params.numIters << " epochs was " << totalTime / 1000.0 << " s"
             << std::endl;
+  std::cout << "Ran " << refreshSchedule.Refreshes() << " " << refreshName << "(s) in "
+            << refreshSchedule.Iterations() << " iterations" << std::endl;
+  if (precisionMonitor) {
+    std::cout << "Bootstraps: " << precisionMonitor->SingleBootstraps() << " single, "
+              << precisionMonitor->DoubleBootstraps() << " double (" << precisionMonitor->FailedProbes()
+              << " single bootstraps over the target redone)" << std::endl;
+  }
+  if (keyProvider) {
+    keyProvider->PrintStats();
+  }
 }
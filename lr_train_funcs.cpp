@@ -34,7 +34,9 @@
 #include "pt_matrix.h"
 #include "utils/debug.h"
 #include "enc_matrix.h"
+#include "depth_schedule.h"
 #include "math.h"
+#include <numeric>
 
 ////////////////////////////////////////////////////////////////////////////
 // Observe that if we pass in the scalingFactor (e.g lr / numRows) we can save on a multiplication
@@ -43,38 +45,108 @@ Mat InitializeLogReg(Mat &X, Mat &y, float scalingFactor) {
   // update this for our problem
   /////////////////////////////////////////
 
-  if (X.size() <= 0) {
+  if (X.NumRows() <= 0) {
     std::cerr << "Please provide a data matrix with positive number of rows." << std::endl;
     exit(0);
   }
 
 #ifdef ENABLE_DEBUG
   std::cerr << "Initialization - Input data X (showing only 5 rows): " << std::endl;
-  Mat Xsub = Mat(X.begin(), X.begin()+5);
-  PrintMatrix(Xsub);
+  PrintSubmatrix(X, 5, X.NumCols());
   std::cerr << std::endl;
 #endif // ENABLE_DEBUG
 
   // Compute X transpose
   //note X tranpose is the same CT packing as x Just labeled differntly since
   // X mat_col_major == X' mat_row_major
-  //copy XT = X
-  Mat XT = Mat(X.begin(), X.end());
-
-  // take negative of XT
-  MatrixScalarMult(XT, -1.0 * scalingFactor);
+  // XT = -scalingFactor * X, written in one pass instead of copying X and scaling the copy
+  Mat XT(X.NumRows(), X.NumCols());
+  auto x = X.Data();
+  auto xt = XT.Data();
+  prim_type negScale = -1.0 * scalingFactor;
+  for (usint k = 0; k < X.NumElements(); k++) {
+    xt[k] = negScale * x[k];
+  }
 
 #ifdef ENABLE_DEBUG
   std::cerr << "Initialization - X transpose (showing only 5 rows, 5 columns): " << std::endl;
-  Mat XTsub = Mat(5);
-  for (usint i=0; i<XTsub.size(); i++)
-    XTsub[i] = Vec(XT[i].begin(), XT[i].begin()+5);
-  PrintMatrix(XTsub);
+  PrintSubmatrix(XT, 5, 5);
   std::cerr << std::endl;
 #endif // ENABLE_DEBUG
   return (XT);
 }
 
+///////////////////////////////////////////////////////////////////////////////////////
+SigmoidEvaluator::SigmoidEvaluator(SigmoidFit fit, double rangeStart, double rangeEnd, usint degree, double scale,
+                                   const std::vector<double> &logitSamples)
+    : fit(fit), rangeStart(rangeStart), rangeEnd(rangeEnd), degree(degree), scale(scale) {
+  if (rangeStart >= rangeEnd || degree < 1 || scale == 0) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) +
+        std::string("Error: sigmoid needs rangeStart < rangeEnd, a positive degree and a nonzero scale"));
+  }
+  // the scale is folded into the coefficients, so it costs no extra level
+  auto f = [scale](double x) { return scale / (1 + std::exp(-x)); };
+  coefficients = FitChebyshevSeries(fit, f, rangeStart, rangeEnd, degree, logitSamples);
+  error = ChebyshevSeriesError(coefficients, f, rangeStart, rangeEnd, logitSamples);
+  error.maxError /= std::abs(scale);
+  error.meanError /= std::abs(scale);
+  error.sampleMeanError /= std::abs(scale);
+}
+
+CT SigmoidEvaluator::Evaluate(CC &cc, const CT &ctLogits) const {
+  return cc->EvalChebyshevSeries(ctLogits, coefficients, rangeStart, rangeEnd);
+}
+
+usint SigmoidEvaluator::Depth() const {
+  return ChebyshevDepth(degree);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+std::vector<usint> SigmoidScheduleDegrees(usint degree) {
+  std::vector<usint> degrees;
+  usint finalDepth = ChebyshevDepth(degree);
+  for (usint d = 1; d < degree; d++) {
+    usint depth = ChebyshevDepth(d);
+    if (depth < finalDepth && ChebyshevDepth(d + 1) > depth) {
+      degrees.push_back(d);
+    }
+  }
+  return degrees;
+}
+
+SigmoidSchedule::SigmoidSchedule(SigmoidFit fit, double rangeStart, double rangeEnd, usint degree, double scale,
+                                 const std::vector<double> &logitSamples, bool adaptive) {
+  SigmoidEvaluator finalStage(fit, rangeStart, rangeEnd, degree, scale, logitSamples);
+  if (adaptive) {
+    // a lower degree only loses accuracy as its range widens, so bisect on the range
+    const usint SHRINK_STEPS = 20;
+    double target = finalStage.Error().maxError;
+    for (auto stageDegree : SigmoidScheduleDegrees(degree)) {
+      double lo = 0;
+      double hi = 1;
+      for (usint step = 0; step < SHRINK_STEPS; step++) {
+        double mid = (lo + hi) / 2;
+        SigmoidEvaluator candidate(fit, mid * rangeStart, mid * rangeEnd, stageDegree, scale, logitSamples);
+        (candidate.Error().maxError <= target ? lo : hi) = mid;
+      }
+      if (lo > 0) {
+        stages.emplace_back(fit, lo * rangeStart, lo * rangeEnd, stageDegree, scale, logitSamples);
+      }
+    }
+  }
+  stages.push_back(finalStage);
+}
+
+const SigmoidEvaluator &SigmoidSchedule::Select(double logitBound) const {
+  for (auto &stage : stages) {
+    if (-stage.RangeStart() >= logitBound && stage.RangeEnd() >= logitBound) {
+      return stage;
+    }
+  }
+  return stages.back();
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////
 void EncLogRegCalculateGradient(
     CC &cc,
@@ -86,12 +158,12 @@ void EncLogRegCalculateGradient(
     const usint rowSize,
     const MatKeys &rowKeys,
     const MatKeys &colKeys,
+    const PT &ptRowStartMask,
     const KeyPair &keys,
+    const SigmoidEvaluator &sigmoid,
     bool debug,
-    int chebRangeStart,
-    int chebRangeEnd,
-    int chebPolyDegree,
-    int debugPlaintextLength
+    int debugPlaintextLength,
+    usint hoistRadix
 ) {
   OPENFHE_DEBUG_FLAG(false);
   // We use the same notation as in
@@ -110,7 +182,55 @@ void EncLogRegCalculateGradient(
   }
 
   // Line 4
-  MatrixVectorProductRow(cc, keys, colKeys, ctX, ctThetas, rowSize, ctLogits);
+  if (hoistRadix > 0) {
+    MatrixVectorProductRowHoisted(cc, ctX, ctThetas, rowSize, ptRowStartMask, ctLogits, hoistRadix);
+  } else {
+    MatrixVectorProductRow(cc, keys, colKeys, ctX, ctThetas, rowSize, ctLogits);
+  }
+  if (debug) {
+    cc->Decrypt(keys.secretKey, ctLogits, &dbg);
+    dbg->SetLength(debugPlaintextLength);
+    std::cout << "\tLogits: " << dbg;
+    std::cout << "\tLogits level: " << ctLogits->GetLevel() << "\n" << std::endl;
+  }
+
+  auto residual = EvalResidual(cc, ctLogits, ctLabels, keys, sigmoid, debug, debugPlaintextLength);
+
+  if (hoistRadix > 0) {
+    MatrixVectorProductColHoisted(cc, ctNegXt, residual, rowSize, ctGradStoreInto, hoistRadix);
+  } else {
+    MatrixVectorProductCol(cc, rowKeys, ctNegXt, residual, rowSize, ctGradStoreInto);
+  }
+
+  if (debug) {
+    cc->Decrypt(keys.secretKey, ctGradStoreInto, &dbg);
+    dbg->SetLength(debugPlaintextLength);
+    std::cout << "\tScaled gradients: " << dbg;
+      std::cout << "\tctGrad store into level: " << ctGradStoreInto->GetLevel() << "\n" << std::endl;
+  }
+
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+void EncLogRegCalculateGradientDiag(
+    CC &cc,
+    const std::vector<CT> &ctXDiags,
+    const std::vector<CT> &ctNegXtDiags,
+    const CT &ctLabels,
+    CT &ctThetas,
+    CT &ctGradStoreInto,
+    const usint rowSize,
+    const KeyPair &keys,
+    const SigmoidEvaluator &sigmoid,
+    bool debug,
+    int debugPlaintextLength,
+    usint hoistRadix
+) {
+  CT ctLogits;
+  PT dbg;
+
+  // one logit per slot, no mask
+  MatrixVectorProductDiag(cc, ctXDiags, ctThetas, rowSize, ctLogits);
   if (debug) {
     cc->Decrypt(keys.secretKey, ctLogits, &dbg);
     dbg->SetLength(debugPlaintextLength);
@@ -118,8 +238,35 @@ void EncLogRegCalculateGradient(
     std::cout << "\tLogits level: " << ctLogits->GetLevel() << "\n" << std::endl;
   }
 
+  auto residual = EvalResidual(cc, ctLogits, ctLabels, keys, sigmoid, debug, debugPlaintextLength);
+
+  // the block sum after the diagonal products has no EvalSum fallback, so it always hoists
+  MatrixTransposeVectorProductDiag(cc, ctNegXtDiags, residual, rowSize, ctGradStoreInto,
+                                   std::max(hoistRadix, usint(2)));
+
+  if (debug) {
+    cc->Decrypt(keys.secretKey, ctGradStoreInto, &dbg);
+    dbg->SetLength(debugPlaintextLength);
+    std::cout << "\tScaled gradients: " << dbg;
+    std::cout << "\tctGrad store into level: " << ctGradStoreInto->GetLevel() << "\n" << std::endl;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+CT EvalResidual(
+    CC &cc,
+    const CT &ctLogits,
+    const CT &ctLabels,
+    const KeyPair &keys,
+    const SigmoidEvaluator &sigmoid,
+    bool debug,
+    int debugPlaintextLength
+) {
+  OPENFHE_DEBUG_FLAG(false);
+  PT dbg;
+
   // Line 5/6
-  auto preds = cc->EvalLogistic(ctLogits, chebRangeStart, chebRangeEnd, chebPolyDegree);
+  CT preds = sigmoid.Evaluate(cc, ctLogits);
   if (debug) {
     cc->Decrypt(keys.secretKey, preds, &dbg);
     dbg->SetLength(debugPlaintextLength);
@@ -137,23 +284,111 @@ void EncLogRegCalculateGradient(
     std::cout << "\tResiduals " << dbg;
     std::cout << "\tResidual level: " << residual->GetLevel() << "\n" << std::endl;
   }
+  return residual;
+}
 
-  MatrixVectorProductCol(cc, rowKeys, ctNegXt, residual, rowSize, ctGradStoreInto);
+///////////////////////////////////////////////////////////////////////////////////////
+void EncLogRegCalculateGradient(
+    CC &cc,
+    const EncDataset &data,
+    CT &ctThetas,
+    CT &ctGradStoreInto,
+    const MatKeys &rowKeys,
+    const MatKeys &colKeys,
+    const PT &ptRowStartMask,
+    const KeyPair &keys,
+    const SigmoidEvaluator &sigmoid,
+    const std::vector<usint> &shardIndices,
+    bool debug,
+    int debugPlaintextLength,
+    usint hoistRadix
+) {
+  std::vector<usint> batch = shardIndices;
+  if (batch.empty()) {
+    batch.resize(data.NumShards());
+    std::iota(batch.begin(), batch.end(), 0);
+  }
+  usint numShards = batch.size();
+  if (numShards == 0) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) +
+        std::string("Error: encrypted dataset has no shards"));
+  }
+  if (sigmoid.Scale() != data.LabelScale()) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) +
+        std::string("Error: sigmoid scale does not match the label scale of the encrypted dataset"));
+  }
 
-  if (debug) {
-    cc->Decrypt(keys.secretKey, ctGradStoreInto, &dbg);
-    dbg->SetLength(debugPlaintextLength);
-    std::cout << "\tScaled gradients: " << dbg;
-      std::cout << "\tctGrad store into level: " << ctGradStoreInto->GetLevel() << "\n" << std::endl;
+  // The debug output decrypts and prints intermediate values, which only makes sense for one shard
+  bool shardDebug = debug && (numShards == 1);
+  std::vector<CT> shardGradients(numShards);
+
+#pragma omp parallel for
+  for (usint batchI = 0; batchI < numShards; batchI++) {
+    usint shardI = batch[batchI];
+    if (data.layout == MatVecLayout::DIAGONAL) {
+      // each shard owns rowSize consecutive diagonal ciphertexts of X and of -X'
+      usint d = data.CtsPerShard();
+      std::vector<CT> xDiags(data.ctX.begin() + shardI * d, data.ctX.begin() + (shardI + 1) * d);
+      std::vector<CT> negXtDiags(data.ctNegXt.begin() + shardI * d, data.ctNegXt.begin() + (shardI + 1) * d);
+      EncLogRegCalculateGradientDiag(cc, xDiags, negXtDiags, data.ctY.at(shardI), ctThetas, shardGradients[batchI],
+                                     data.rowSize, keys, sigmoid, shardDebug, debugPlaintextLength, hoistRadix);
+      continue;
+    }
+    // single-X bundles reuse ctX for the gradient product, with the scale carried by ctY
+    const CT &ctGradMatrix = data.singleX ? data.ctX.at(shardI) : data.ctNegXt.at(shardI);
+    EncLogRegCalculateGradient(cc, data.ctX.at(shardI), ctGradMatrix, data.ctY.at(shardI),
+                               ctThetas, shardGradients[batchI],
+                               data.rowSize, rowKeys, colKeys, ptRowStartMask, keys,
+                               sigmoid, shardDebug, debugPlaintextLength, hoistRadix
+    );
   }
 
+  if (numShards == 1) {
+    ctGradStoreInto = shardGradients[0];
+  } else {
+    ctGradStoreInto = cc->EvalAddMany(shardGradients);
+  }
+}
+
+///////////////////////////////////////////////////////////////
+CT ThetaFromPackedWeights(
+    CC &cc,
+    const CT &ctWeights,
+    const CT &ctWeightsRotated,
+    const PT &ptExtractThetaMask,
+    const PT &ptExtractPhiMask
+) {
+  // the rotated weights carry theta in the odd blocks
+  return cc->EvalAdd(cc->EvalMult(ctWeights, ptExtractThetaMask), cc->EvalMult(ctWeightsRotated, ptExtractPhiMask));
+}
+
+///////////////////////////////////////////////////////////////
+CT PackedNagStep(
+    CC &cc,
+    const CT &ctWeights,
+    const CT &ctWeightsRotated,
+    const CT &ctScaledGradient,
+    const PT &ptWeightsFactor,
+    const PT &ptRotatedFactor,
+    const PT &ptFirstGradientFactor,
+    bool firstIteration
+) {
+  // the factors multiply the shallow weights and the deep gradient is only subtracted, except in the
+  //    first iteration, where scaling the gradient costs a level
+  CT ctMomentum = cc->EvalAdd(cc->EvalMult(ctWeights, ptWeightsFactor), cc->EvalMult(ctWeightsRotated, ptRotatedFactor));
+  if (firstIteration) {
+    return cc->EvalSub(ctMomentum, cc->EvalMult(ctScaledGradient, ptFirstGradientFactor));
+  }
+  return cc->EvalSub(ctMomentum, ctScaledGradient);
 }
 
 ///////////////////////////////////////////////////////////////
 void BoundCheckMat(const Mat &inMat, const double bound) {
 
-  usint numRows = inMat.size();
-  usint numCols = inMat[0].size();
+  usint numRows = inMat.NumRows();
+  usint numCols = inMat.NumCols();
 
   //yes this is slow...
   for (usint i = 0; i < numRows; i++) {
@@ -191,56 +426,37 @@ int ReturnDepth(const CT &ct) {
   return (mulDepth);
 }
 
+LossStats ComputeLossAndAccuracy(const Mat &b, const Mat &X, const Mat &y) {
+  // Single pass over X: for each sample z = x . b and
+  //    -y log(sigmoid(z)) - (1 - y) log(1 - sigmoid(z)) = softplus(z) - y z
+  //    with softplus(z) = max(z, 0) + log1p(exp(-|z|)), which never overflows or takes log(0)
+  usint numSamp = X.NumRows();
+  usint numFeat = X.NumCols();
+  if (b.NumRows() != numFeat || y.NumRows() != numSamp) {
+    throw std::invalid_argument("ComputeLoss: dimension mismatch");
+  }
+  const prim_type *beta = b.Data();
+  const prim_type *x = X.Data();
+  const prim_type *labels = y.Data();
+  usint labelStride = y.NumCols();
+
+  double lossSum = 0.0;
+  usint numCorrect = 0;
+#pragma omp parallel for reduction(+:lossSum, numCorrect)
+  for (usint i = 0; i < numSamp; i++) {
+    const prim_type *row = x + size_t(i) * numFeat;
+    double z = 0.0;
+#pragma omp simd reduction(+:z)
+    for (usint j = 0; j < numFeat; j++) {
+      z += row[j] * beta[j];
+    }
+    double label = labels[size_t(i) * labelStride];
+    lossSum += std::max(z, 0.0) + std::log1p(std::exp(-std::abs(z))) - label * z;
+    numCorrect += ((z >= 0.0) == (label >= 0.5));
+  }
+  return LossStats{lossSum / double(numSamp), double(numCorrect) / double(numSamp)};
+}
+
 double ComputeLoss(const Mat &b, const Mat &X, const Mat &y) {
-  // Based off of https://stackoverflow.com/a/47798689/18031872
-  OPENFHE_DEBUG_FLAG(false);
-  OPENFHE_DEBUG("In ComputeLoss");
-  usint numSamp = X.size();     //n_samp
-
-  /////////////////////////////////////////////////////////////////
-  //Calculate t1: matmul(-y.T, log(yHat)
-  /////////////////////////////////////////////////////////////////
-  //yHat = sigmoid(X * beta);
-  Mat yHat = Mat(numSamp, Vec(1, 0.0));
-  MatrixMult(X, b, yHat);
-  MatrixSigmoid(yHat);
-  // log(yHat)
-  Mat logYHat = Mat(numSamp, Vec(1, 0.0));
-  MatrixLog(yHat, logYHat);
-
-  Mat yT = Mat(y[0].size(), Vec(y.size(), 0.0));
-  MatrixTransp(y, yT);
-  MatrixScalarMult(yT, -1);
-  Mat t1Mat = Mat(1, Vec(1, 0.0));
-  MatrixMult(yT, logYHat, t1Mat);
-  //PrintMatrix(t1Mat);
-
-  /////////////////////////////////////////////////////////////////
-  //t2: matmult(
-  //    t2_a,
-  //    t2_b
-  //    )
-  // t2_a = 1 - y.T
-  // t2_b = log(1 - yHat)
-  /////////////////////////////////////////////////////////////////
-  // from earlier it exists as -yT. We change it back here
-  // so we can do a sub. Less confusing for newer readers
-  Mat t2Mat_a = Mat(yT.size(), Vec(yT[0].size(), 0.0));
-  MatrixScalarMult(yT, -1);
-  // Getting t2_a
-  ScalarSubMat(1, yT, t2Mat_a);
-  OPENFHE_DEBUG("Got t2_a: 1-yT");
-
-  Mat t2Mat_b = Mat(y.size(), Vec(1, 0.0));
-  ScalarSubMat(1, yHat, t2Mat_b);
-  MatrixLog(t2Mat_b, t2Mat_b);
-  OPENFHE_DEBUG("Got t2_b: log(1-yHat)");
-
-  Mat t2Mat = Mat(1, Vec(1, 0.0));
-  MatrixMult(t2Mat_a, t2Mat_b, t2Mat);
-
-  // Should now have a Mat Scalar that we add up
-  Mat loglikelihood = Mat(1, Vec(1, 0.0));
-  MatrixMatrixSub(t1Mat, t2Mat, loglikelihood);
-  return loglikelihood[0][0] / double(numSamp);
+  return ComputeLossAndAccuracy(b, X, y).loss;
 }
@@ -33,6 +33,9 @@
 #define DPRIVE_ML__LR_TRAIN_FUNCS_H_
 
 #include "lr_types.h"
+#include "enc_dataset.h"
+#include "enc_matrix.h"
+#include "sigmoid_approx.h"
 #include "openfhe.h"
 
 ////////// Function declarations related to logistic regression training on encrypted data ///////////////////////////////
@@ -50,12 +53,75 @@
 
 Mat InitializeLogReg(Mat &X, Mat &y, float scalingFactor = 1.0);
 
+/* scale * sigmoid(x) as a Chebyshev series over [rangeStart, rangeEnd]. The coefficients are fitted
+ * once at construction (see sigmoid_approx.h for the fits) instead of by every EvalLogistic call,
+ * and evaluated with EvalChebyshevSeries. With the CHEBYSHEV fit the result is exactly EvalLogistic's.
+ * logitSamples (see SampleNagLogits) are needed by the EMPIRICAL fit and, for any fit, add the mean
+ * error over them to Error().
+ */
+class SigmoidEvaluator {
+ public:
+  SigmoidEvaluator(SigmoidFit fit, double rangeStart, double rangeEnd, usint degree, double scale = 1.0,
+                   const std::vector<double> &logitSamples = {});
+
+  CT Evaluate(CC &cc, const CT &ctLogits) const;
+
+  // levels Evaluate consumes
+  usint Depth() const;
+
+  // error against sigmoid over the range (and the logit samples), measured at construction and
+  //    divided by |scale| so fits at different scales compare
+  const ApproxError &Error() const { return error; }
+
+  SigmoidFit Fit() const { return fit; }
+  usint Degree() const { return degree; }
+  double RangeStart() const { return rangeStart; }
+  double RangeEnd() const { return rangeEnd; }
+  double Scale() const { return scale; }
+  const std::vector<double> &Coefficients() const { return coefficients; }
+
+ private:
+  SigmoidFit fit;
+  double rangeStart;
+  double rangeEnd;
+  usint degree;
+  double scale;
+  std::vector<double> coefficients;
+  ApproxError error;
+};
+
+/* Sigmoid evaluators for iterations whose logits are known to stay small. The weights start at zero,
+ * so early logits sit near the origin, where a lower degree over a narrower range is as accurate as
+ * the final approximation over the full one. Each stage takes the largest degree of a Chebyshev
+ * depth below the final one (see SigmoidScheduleDegrees) over the widest range, shrunk towards 0,
+ * where its maximum error stays within that of the final stage. An iteration runs the first stage
+ * whose range covers its logit bound, saving a level per depth step and most of the polynomial.
+ */
+class SigmoidSchedule {
+ public:
+  // adaptive false holds the final evaluator only
+  SigmoidSchedule(SigmoidFit fit, double rangeStart, double rangeEnd, usint degree, double scale,
+                  const std::vector<double> &logitSamples, bool adaptive);
+
+  // the first stage whose range covers [-logitBound, logitBound], the final one if none does
+  const SigmoidEvaluator &Select(double logitBound) const;
+
+  const std::vector<SigmoidEvaluator> &Stages() const { return stages; }
+  const SigmoidEvaluator &Final() const { return stages.back(); }
+
+ private:
+  std::vector<SigmoidEvaluator> stages;
+};
+
+// degrees of the stages before the final one of the given degree: the largest of each lower Chebyshev depth
+std::vector<usint> SigmoidScheduleDegrees(usint degree);
+
 /**
  * Calculate the lr-scaled gradient. Based on the log-likelihood
  * @param cc                Cryptocontext
  * @param ctX               Features
- * @param ctNegXt           -features transposed
- * @param ctLabels          features
+ * @param ctNegXt           -features transposed. May be ctX when ctLabels carries the scale
+ * @param ctLabels          labels, scaled by the sigmoid scale
  * @param ctThetas           weights
  * @param ctGradStoreInto        gradients
  * @param lr                learning rate
@@ -64,8 +130,14 @@ Mat InitializeLogReg(Mat &X, Mat &y, float scalingFactor = 1.0);
  * @param origNumSamples    Number of samples
  * @param rowKeys           keys for row operations
  * @param colKeys           keys for col operations
+ * @param ptRowStartMask    row start mask of the hoisted row sums (see MakeRowStartMask)
  * @param keys              keys for enc/dec
+ * @param sigmoid           sigmoid approximation. Its scale is folded into the coefficients: with
+ *                          ctLabels = -c * y and scale -c the residual is c * (sigmoid - y), so X itself
+ *                          yields the same gradient as NegXt without spending a level
  * @param withBT            whether to run bootstrapping
+ * @param hoistRadix        radix of the hoisted row/column sums (see HoistedRotateSum). 0 uses
+ *                          OpenFHE's EvalSumCols/EvalSumRows with rowKeys/colKeys
  */
 void EncLogRegCalculateGradient(
     CC &cc,
@@ -77,12 +149,122 @@ void EncLogRegCalculateGradient(
     usint rowSize,
     const MatKeys &rowKeys,
     const MatKeys &colKeys,
+    const PT &ptRowStartMask,
     const KeyPair &keys,
+    const SigmoidEvaluator &sigmoid,
     bool debug=false,
-    int chebRangeStart = -64,
-    int chebRangeEnd = 64,
-    int chebPolyDegree = 128,
-    int debugPlaintextLength=32
+    int debugPlaintextLength=32,
+    usint hoistRadix = HOIST_RADIX_DEF
+    );
+
+/**
+ * Calculate the lr-scaled gradient of one shard stored in the diagonal layout (see
+ * MatrixVectorProductDiag): rowSize diagonal ciphertexts of X and of -X', one label per slot.
+ * The logits take one level less than with MatrixVectorProductRow and the gradient comes out
+ * VEC_ROW_CLONED like the row-major one.
+ * @param ctXDiags          forward diagonals of X
+ * @param ctNegXtDiags      transposed diagonals of -X'
+ * @param hoistRadix        radix of the closing block sum, raised to 2 when 0
+ */
+void EncLogRegCalculateGradientDiag(
+    CC &cc,
+    const std::vector<CT> &ctXDiags,
+    const std::vector<CT> &ctNegXtDiags,
+    const CT &ctLabels,
+    CT &ctThetas,
+    CT &ctGradStoreInto,
+    usint rowSize,
+    const KeyPair &keys,
+    const SigmoidEvaluator &sigmoid,
+    bool debug=false,
+    int debugPlaintextLength=32,
+    usint hoistRadix = HOIST_RADIX_DEF
+    );
+
+/**
+ * The residual ctLabels - sigmoid(ctLogits) shared by both layouts
+ */
+CT EvalResidual(
+    CC &cc,
+    const CT &ctLogits,
+    const CT &ctLabels,
+    const KeyPair &keys,
+    const SigmoidEvaluator &sigmoid,
+    bool debug,
+    int debugPlaintextLength
+    );
+
+/**
+ * Calculate the lr-scaled gradient over the shards of a row-sharded dataset.
+ * Shards are processed in parallel and the per-shard gradients summed into ctGradStoreInto.
+ * -X' is pre-scaled by the number of rows in a batch, so the sum is the (mini-)batch gradient.
+ * @param cc                Cryptocontext
+ * @param data              row-sharded encrypted X, -X' and labels
+ * @param ctThetas          weights
+ * @param ctGradStoreInto   gradients
+ * @param rowKeys           keys for row operations
+ * @param colKeys           keys for col operations
+ * @param ptRowStartMask    row start mask of the hoisted row sums (see MakeRowStartMask)
+ * @param keys              keys for enc/dec
+ * @param sigmoid           sigmoid approximation, its scale must be data.LabelScale()
+ * @param shardIndices      shards making up this batch. Empty means every shard (full batch)
+ *                          Shards are dispatched on data.layout
+ * @param hoistRadix        radix of the hoisted row/column sums, 0 uses EvalSumCols/EvalSumRows
+ */
+void EncLogRegCalculateGradient(
+    CC &cc,
+    const EncDataset &data,
+    CT &ctThetas,
+    CT &ctGradStoreInto,
+    const MatKeys &rowKeys,
+    const MatKeys &colKeys,
+    const PT &ptRowStartMask,
+    const KeyPair &keys,
+    const SigmoidEvaluator &sigmoid,
+    const std::vector<usint> &shardIndices = {},
+    bool debug=false,
+    int debugPlaintextLength=32,
+    usint hoistRadix = HOIST_RADIX_DEF
+    );
+
+/* Packed NAG weight state: the weights ciphertext W holds theta in the even rowSize blocks and
+ * (1 + eta) phi in the odd ones. With the gradient pre-scaled by (1 + eta) (folded into -X'), both
+ * halves of the NAG update
+ *    phi' = theta - grad,   theta' = phi' + eta (phi' - phi)
+ * become one linear map of W and Wr = Rotate(W, rowSize), whose blocks are swapped:
+ *    theta'          = (1 + eta) theta - eta / (1 + eta) * (1 + eta) phi - (1 + eta) grad
+ *    (1 + eta) phi'  = (1 + eta) theta                                   - (1 + eta) grad
+ * So the update needs no extraction and no repacking masks after the gradient: the weights come
+ * back packed at the level of the gradient, ready for the single bootstrap (or re-encryption).
+ */
+
+/**
+ * theta repeated every rowSize slots (VEC_ROW_CLONED) from the packed weights and their rotation:
+ * W * thetaMask + Wr * phiMask. One level, no rotation besides Wr
+ */
+CT ThetaFromPackedWeights(
+    CC &cc,
+    const CT &ctWeights,
+    const CT &ctWeightsRotated,
+    const PT &ptExtractThetaMask,
+    const PT &ptExtractPhiMask
+    );
+
+/**
+ * The NAG update on the packed weights, see MakeNagStepFactors for the factors
+ * @param ctScaledGradient  (1 + eta) times the gradient, VEC_ROW_CLONED
+ * @param firstIteration    theta' = phi' without momentum. Scales the gradient of the theta blocks
+ *                          back by 1 / (1 + eta), which takes one level in this iteration only
+ */
+CT PackedNagStep(
+    CC &cc,
+    const CT &ctWeights,
+    const CT &ctWeightsRotated,
+    const CT &ctScaledGradient,
+    const PT &ptWeightsFactor,
+    const PT &ptRotatedFactor,
+    const PT &ptFirstGradientFactor,
+    bool firstIteration
     );
 
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -104,4 +286,12 @@ int ReturnDepth(const CT &ct);
 // Formulation based off of: https://stackoverflow.com/a/47798689/18031872
 double ComputeLoss(const Mat &betas, const Mat &X, const Mat &y);
 
+struct LossStats {
+  double loss;      // mean cross-entropy
+  double accuracy;  // fraction of samples where sigmoid(x . betas) >= 0.5 matches y >= 0.5
+};
+
+// cross-entropy and accuracy in one fused pass over X, threaded across rows
+LossStats ComputeLossAndAccuracy(const Mat &betas, const Mat &X, const Mat &y);
+
 #endif //DPRIVE_ML__LR_TRAIN_FUNCS_H_
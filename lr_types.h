@@ -33,13 +33,15 @@
 #define DPRIVE_ML__LR_TYPES_H_
 
 #include "openfhe.h"
+#include "flat_matrix.h"
 
 typedef std::numeric_limits<double> dbl;
 
 //todo replace typedef with using =
 typedef double prim_type; //do we really need this still? Ideally it is so code works with other POD types
 typedef std::vector<prim_type> Vec;
-typedef std::vector<std::vector<prim_type>> Mat;
+typedef FlatMatrix<prim_type> Mat;  // contiguous row-major, see flat_matrix.h
+typedef MatrixView<const prim_type> MatView;
 
 using CC = lbcrypto::CryptoContext<lbcrypto::DCRTPoly>; //crypto contexts
 using CT = lbcrypto::Ciphertext<lbcrypto::DCRTPoly>; //ciphertext
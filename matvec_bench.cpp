@@ -0,0 +1,201 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+// Benchmarks the row-major and the diagonal (BSGS) matrix-vector products across feature widths:
+//    per width it encrypts the same random dataset in both layouts, times X theta and X' (X theta)
+//    over every shard, checks them against the plaintext products and prints the cost model's
+//    estimate and choice next to the measurements
+//    usage: matvec_bench [ring dimension] [samples] [max width] [repetitions]
+//    defaults to 1 << 14, one diagonal shard worth of samples (ring dimension / 2) and widths 16 to 1024
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include "enc_dataset.h"
+#include "enc_matrix.h"
+#include "utils.h"
+
+namespace {
+
+// shard ciphertexts [shardI * perShard, (shardI + 1) * perShard)
+std::vector<CT> ShardCts(const std::vector<CT> &cts, usint shardI, usint perShard) {
+  return std::vector<CT>(cts.begin() + shardI * perShard, cts.begin() + (shardI + 1) * perShard);
+}
+
+// X' (X theta) over every shard of data, one forward and one transposed product per shard
+CT Gradient(CC &cc, const EncDataset &data, const CT &ctTheta, const PT &ptRowStartMask, usint radix,
+            double &forwardMs, double &backwardMs) {
+  usint d = data.CtsPerShard();
+  std::vector<CT> logits(data.NumShards());
+  std::vector<CT> grads(data.NumShards());
+  auto start = std::chrono::high_resolution_clock::now();
+#pragma omp parallel for
+  for (usint shardI = 0; shardI < data.NumShards(); shardI++) {
+    if (data.layout == MatVecLayout::DIAGONAL) {
+      MatrixVectorProductDiag(cc, ShardCts(data.ctX, shardI, d), ctTheta, data.rowSize, logits[shardI]);
+    } else {
+      MatrixVectorProductRowHoisted(cc, data.ctX[shardI], ctTheta, data.rowSize, ptRowStartMask, logits[shardI],
+                                    radix);
+    }
+  }
+  auto mid = std::chrono::high_resolution_clock::now();
+#pragma omp parallel for
+  for (usint shardI = 0; shardI < data.NumShards(); shardI++) {
+    if (data.layout == MatVecLayout::DIAGONAL) {
+      MatrixTransposeVectorProductDiag(cc, ShardCts(data.ctNegXt, shardI, d), logits[shardI], data.rowSize,
+                                       grads[shardI], radix);
+    } else {
+      MatrixVectorProductColHoisted(cc, data.ctNegXt[shardI], logits[shardI], data.rowSize, grads[shardI], radix);
+    }
+  }
+  CT grad = (grads.size() == 1) ? grads[0] : cc->EvalAddMany(grads);
+  auto end = std::chrono::high_resolution_clock::now();
+  forwardMs = std::chrono::duration<double, std::milli>(mid - start).count();
+  backwardMs = std::chrono::duration<double, std::milli>(end - mid).count();
+  return grad;
+}
+
+// max |grad_j - ref_j| / max |ref_j| over the first numFeatures slots
+double RelativeError(CC &cc, const KeyPair &keys, const CT &ctGrad, const Vec &ref) {
+  PT pt;
+  cc->Decrypt(keys.secretKey, ctGrad, &pt);
+  auto grad = pt->GetRealPackedValue();
+  double diff = 0;
+  double scale = 0;
+  for (usint j = 0; j < ref.size(); j++) {
+    diff = std::max(diff, std::abs(grad[j] - ref[j]));
+    scale = std::max(scale, std::abs(ref[j]));
+  }
+  return diff / scale;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  usint ringDim = (argc > 1) ? atoi(argv[1]) : 1 << 14;
+  usint numSlots = ringDim / 2;
+  usint numSamples = (argc > 2) ? atoi(argv[2]) : numSlots;
+  usint maxWidth = (argc > 3) ? atoi(argv[3]) : 1024;
+  usint reps = std::max((argc > 4) ? atoi(argv[4]) : 3, 1);
+  usint radix = HOIST_RADIX_DEF;
+
+  CryptoParams parameters;
+  parameters.SetMultiplicativeDepth(4);
+  parameters.SetScalingModSize(50);
+  parameters.SetBatchSize(numSlots);
+  parameters.SetRingDim(ringDim);
+  parameters.SetSecurityLevel(lbcrypto::HEStd_NotSet);
+  parameters.SetScalingTechnique(lbcrypto::FIXEDAUTO);
+  parameters.SetKeySwitchTechnique(lbcrypto::HYBRID);
+  CC cc = GenCryptoContext(parameters);
+  cc->Enable(lbcrypto::PKE);
+  cc->Enable(lbcrypto::LEVELEDSHE);
+  cc->Enable(lbcrypto::ADVANCEDSHE);
+  KeyPair keys = cc->KeyGen();
+  cc->EvalMultKeyGen(keys.secretKey);
+
+  std::cout << "ring dimension " << ringDim << ", " << numSlots << " slots, " << numSamples << " samples, radix "
+            << radix << ", best of " << reps << " runs" << std::endl;
+  std::cout << std::left << std::setw(8) << "width" << std::setw(8) << "layout" << std::right << std::setw(8)
+            << "shards" << std::setw(8) << "cts" << std::setw(12) << "model ks" << std::setw(12) << "fwd ms"
+            << std::setw(12) << "bwd ms" << std::setw(12) << "total ms" << std::setw(12) << "rel err"
+            << "  model pick" << std::endl;
+
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  for (usint width = 16; width <= std::min(maxWidth, numSlots); width *= 2) {
+    // entries scaled so the logits stay O(1) at every width
+    Mat X(numSamples, width);
+    Mat y(numSamples, 1);
+    Mat beta(width, 1);
+    for (usint i = 0; i < numSamples; i++) {
+      for (usint j = 0; j < width; j++) {
+        X[i][j] = dist(gen) / std::sqrt(double(width));
+      }
+    }
+    for (usint j = 0; j < width; j++) {
+      beta[j][0] = dist(gen);
+    }
+
+    // reference X' (X beta)
+    Vec ref(width, 0);
+    for (usint i = 0; i < numSamples; i++) {
+      double logit = 0;
+      for (usint j = 0; j < width; j++) {
+        logit += X[i][j] * beta[j][0];
+      }
+      for (usint j = 0; j < width; j++) {
+        ref[j] += X[i][j] * logit;
+      }
+    }
+
+    std::vector<int> rotationIndices;
+    for (auto idx : HoistedMatrixVectorIndices(width, numSlots, radix)) {
+      rotationIndices.push_back(idx);
+    }
+    for (auto idx : DiagonalMatVecIndices(width, numSlots, radix)) {
+      rotationIndices.push_back(idx);
+    }
+    std::sort(rotationIndices.begin(), rotationIndices.end());
+    rotationIndices.erase(std::unique(rotationIndices.begin(), rotationIndices.end()), rotationIndices.end());
+    cc->EvalRotateKeyGen(keys.secretKey, rotationIndices);
+
+    // theta repeated every width slots, as the training loop extracts it
+    CT ctTheta = collateOneDMats2CtVRC(cc, beta, beta, width, numSlots, keys);
+    PT ptRowStartMask;
+    MakeRowStartMask(cc, width, ptRowStartMask);
+    auto picked = ChooseMatVecLayout(numSamples, width, numSlots, radix);
+    for (auto layout : {MatVecLayout::ROW_MAJOR, MatVecLayout::DIAGONAL}) {
+      // X doubles as NegXt: the transposed product then gives X' (X beta)
+      auto data = EncryptDataset(cc, X, X, y, width, numSlots, keys, 0, 0, false, 0, DatasetLevels(), layout);
+      auto cost = EstimateMatVecCost(layout, numSamples, width, numSlots, radix);
+
+      double forwardMs = std::numeric_limits<double>::max();
+      double backwardMs = std::numeric_limits<double>::max();
+      CT ctGrad;
+      for (usint r = 0; r < reps; r++) {
+        double f, b;
+        ctGrad = Gradient(cc, data, ctTheta, ptRowStartMask, radix, f, b);
+        forwardMs = std::min(forwardMs, f);
+        backwardMs = std::min(backwardMs, b);
+      }
+      std::cout << std::left << std::setw(8) << width << std::setw(8) << MatVecLayoutName(layout) << std::right
+                << std::setw(8) << cost.shards << std::setw(8) << cost.ciphertexts << std::setw(12)
+                << cost.keySwitches << std::setw(12) << forwardMs << std::setw(12) << backwardMs << std::setw(12)
+                << forwardMs + backwardMs << std::setw(12) << RelativeError(cc, keys, ctGrad, ref)
+                << ((layout == picked) ? "  *" : "") << std::endl;
+    }
+  }
+  return 0;
+}
@@ -75,11 +75,36 @@ class Parameters {
     std::string outFilePrefix = outFilePrefix_def;
     ringDimension = ringDimension_def;
     btPrecision = btPrecision_def;
+    shardRows = 0;
+    batchShards = 0;
+    shuffleBatches = false;
+    keyStoreDir = "";
+    datasetBundleDir = "";
+    checkpointDir = "";
+    encryptThreads = 0;
+    checkpointEvery = 10;
+    resume = false;
+    singleX = false;
+    hoistRadix = HOIST_RADIX_DEF;
+    matVecLayout = "auto";
+    sigmoidFit = "cheb";
+    sigmoidDegree = 0;
+    itersPerBootstrap = 1;
+    adaptiveSigmoid = false;
+    targetBootstrapError = 0;
+    keyCacheMB = 0;
+    sweepFile = "";
 
     outputPrecision = outputPrecision_def;
 
+    // every option has a short form, --resume is also accepted as a long option
+    static struct option longOptions[] = {
+        {"resume", no_argument, nullptr, 'R'},
+        {nullptr, 0, nullptr, 0}
+    };
+
     int opt;
-    while ((opt = getopt(argc, argv, "bmn:r:x:y:j:k:d:w:p:e:h")) != -1) {
+    while ((opt = getopt_long(argc, argv, "bmn:r:x:y:j:k:d:w:p:e:c:s:oK:D:C:i:Rt:XH:L:F:G:B:AE:M:S:h", longOptions, nullptr)) != -1) {
       switch (opt) {
         case 'b':withBT = true;
           std::cout << "bootstrapping enabled" << std::endl;
@@ -94,6 +119,69 @@ class Parameters {
         case 'e':btPrecision = atoi(optarg);
           std::cout << "Bootstrapping Precision (only valid in 64-bit setups): " << btPrecision << std::endl;
           break;
+          /**
+           * Mini-batch
+           */
+        case 'c':shardRows = atoi(optarg);
+          std::cout << "shardRows: " << shardRows << std::endl;
+          break;
+        case 's':batchShards = atoi(optarg);
+          std::cout << "batchShards: " << batchShards << std::endl;
+          break;
+        case 'o':shuffleBatches = true;
+          std::cout << "shuffling mini-batch shard order every pass" << std::endl;
+          break;
+        case 'K':keyStoreDir = optarg;
+          std::cout << "keyStoreDir: " << keyStoreDir << std::endl;
+          break;
+        case 'D':datasetBundleDir = optarg;
+          std::cout << "datasetBundleDir: " << datasetBundleDir << std::endl;
+          break;
+          /**
+           * Checkpointing
+           */
+        case 'C':checkpointDir = optarg;
+          std::cout << "checkpointDir: " << checkpointDir << std::endl;
+          break;
+        case 'i':checkpointEvery = atoi(optarg);
+          std::cout << "checkpointEvery: " << checkpointEvery << std::endl;
+          break;
+        case 'R':resume = true;
+          std::cout << "resuming from the last checkpoint" << std::endl;
+          break;
+        case 't':encryptThreads = atoi(optarg);
+          std::cout << "encryptThreads: " << encryptThreads << std::endl;
+          break;
+        case 'X':singleX = true;
+          std::cout << "encrypting a single copy of X" << std::endl;
+          break;
+        case 'H':hoistRadix = atoi(optarg);
+          std::cout << "hoistRadix: " << hoistRadix << std::endl;
+          break;
+        case 'L':matVecLayout = optarg;
+          std::cout << "matVecLayout: " << matVecLayout << std::endl;
+          break;
+        case 'F':sigmoidFit = optarg;
+          std::cout << "sigmoidFit: " << sigmoidFit << std::endl;
+          break;
+        case 'G':sigmoidDegree = atoi(optarg);
+          std::cout << "sigmoidDegree: " << sigmoidDegree << std::endl;
+          break;
+        case 'B':itersPerBootstrap = atoi(optarg);
+          std::cout << "itersPerBootstrap: " << itersPerBootstrap << std::endl;
+          break;
+        case 'A':adaptiveSigmoid = true;
+          std::cout << "adapting the sigmoid degree and range to the logit bound" << std::endl;
+          break;
+        case 'E':targetBootstrapError = atof(optarg);
+          std::cout << "targetBootstrapError: " << targetBootstrapError << std::endl;
+          break;
+        case 'M':keyCacheMB = atof(optarg);
+          std::cout << "keyCacheMB: " << keyCacheMB << std::endl;
+          break;
+        case 'S':sweepFile = optarg;
+          std::cout << "sweepFile: " << sweepFile << std::endl;
+          break;
           /**
            * Train-Test files
            */
@@ -132,7 +220,33 @@ class Parameters {
                     << "  -y <training y file name> [" << trainYFile_def << "]" << std::endl
                     << "  -j <testing X file name> [" << testXFile_def << "]" << std::endl
                     << "  -k <testing y file name> [" << testYFile_def << "]" << std::endl
-                    << "  -d <ring dimension> [" << ringDimension_def << "]" << std::endl
+                    << "  -d <ring dimension, 0 picks the smallest secure one> [" << ringDimension_def << "]"
+                    << std::endl
+                    << "  -c <rows per encrypted shard, 0 fills a ciphertext> [0]" << std::endl
+                    << "  -s <shards per mini-batch iteration, 0 is full batch> [0]" << std::endl
+                    << "  -o shuffle the mini-batch shard order every pass [false]" << std::endl
+                    << "  -K <directory to save/reload the context and keys, empty disables> []" << std::endl
+                    << "  -D <encrypted dataset bundle directory to save/reload, empty disables> []" << std::endl
+                    << "  -C <checkpoint directory, empty disables checkpointing> []" << std::endl
+                    << "  -i <iterations between checkpoints> [10]" << std::endl
+                    << "  -R, --resume continue from the last checkpoint in the checkpoint directory" << std::endl
+                    << "  -t <dataset encryption worker threads, 0 uses one per core> [0]" << std::endl
+                    << "  -X encrypt only X and fold the -X' scale into y and the sigmoid [false]" << std::endl
+                    << "  -H <rotations sharing one decomposition per summing stage, 0 uses EvalSumRows/Cols> ["
+                    << HOIST_RADIX_DEF << "]" << std::endl
+                    << "  -L <matrix-vector layout: auto, row (MAT_ROW_MAJOR) or diag (diagonals)> [auto]" << std::endl
+                    << "  -F <sigmoid polynomial fit: cheb (interpolation), lsq (least squares), minimax or elsq"
+                    << " (least squares over the training logits)> [cheb]" << std::endl
+                    << "  -G <sigmoid polynomial degree, 0 uses the program's default> [0]" << std::endl
+                    << "  -B <iterations to size the levels between bootstraps (re-encryptions) for> [1]"
+                    << std::endl
+                    << "  -A start with a low sigmoid degree and range, raised as the logits grow [false]" << std::endl
+                    << "  -E <largest error a bootstrap may add to the weights, picks single or double"
+                    << " bootstrapping per bootstrap (64-bit, needs -e). 0 disables> [0]" << std::endl
+                    << "  -M <MB of rotation and bootstrapping keys kept in memory, the rest is loaded from disk"
+                    << " when needed (needs -b). 0 keeps every key resident> [0]" << std::endl
+                    << "  -S <file of configurations (lrGamma lrEta [rangeStart rangeEnd [degree]] per line) to"
+                    << " train concurrently on one context and dataset, empty trains once> []" << std::endl
                     << "  -w <output file name prefix> [" << outFilePrefix_def << "]" << std::endl
                     << "  -p <outputPrecision> [" << outputPrecision_def << "]" << std::endl
                     << "  -h prints this message" << std::endl;
@@ -141,16 +255,56 @@ class Parameters {
     }
 
     rowsToRead = (rowsToRead == 0) ? -1 : rowsToRead;
+    if (resume && checkpointDir.empty()) {
+      std::cerr << "--resume needs a checkpoint directory (-C)" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    checkpointEvery = (checkpointEvery == 0) ? 1 : checkpointEvery;
+    if (hoistRadix == 1 || (hoistRadix & (hoistRadix - 1)) != 0) {
+      std::cerr << "-H must be 0 or a power of two >= 2" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    if (matVecLayout != "auto" && matVecLayout != "row" && matVecLayout != "diag") {
+      std::cerr << "-L must be auto, row or diag" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    if (targetBootstrapError > 0 && (!withBT || btPrecision <= 0)) {
+      std::cerr << "-E needs bootstrapping (-b) and the double bootstrapping precision (-e)" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    if (keyCacheMB > 0 && !withBT) {
+      std::cerr << "-M needs bootstrapping (-b): an interactive iteration uses every rotation key" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    if (!sweepFile.empty() && (adaptiveSigmoid || !checkpointDir.empty() || keyCacheMB > 0)) {
+      std::cerr << "-S trains every configuration in one pass: it does not take -A, -C or -M" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    if (itersPerBootstrap == 0) {
+      std::cerr << "-B must be at least 1" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    SigmoidFit fit;
+    if (!ParseSigmoidFit(sigmoidFit, fit)) {
+      std::cerr << "-F must be cheb, lsq, minimax or elsq" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    if (singleX && matVecLayout == "diag") {
+      std::cerr << "-X needs the row-major layout: the diagonal products use different packings of X and -X'"
+                << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
     if (withBT) {
-      outFilePrefix = outFilePrefix_def + "bootstrap_";
+      outFilePrefix = outFilePrefix + "bootstrap_";
     } else {
-      outFilePrefix = outFilePrefix_def + "interactive_";
+      outFilePrefix = outFilePrefix + "interactive_";
     }
 
     weightsOutFile = outFilePrefix + "weights.csv";
     trainOutFile = outFilePrefix + "train.csv";
     testLossOutFile = outFilePrefix + "test.csv";
     lossOutFile = outFilePrefix + "loss.csv";
+    sweepOutPrefix = outFilePrefix + "sweep_";
 
     std::cerr.precision(outputPrecision); //set output precision.
     if (verbose) {
@@ -165,6 +319,25 @@ class Parameters {
       std::cout << "\tTest X CSV file: " << testXFile << std::endl;
       std::cout << "\tTest y CSV file: " << testYFile << std::endl;
       std::cout << "\tRing Dimension: " << ringDimension << std::endl << std::endl;
+      std::cout << "\tRows per shard: " << shardRows << std::endl;
+      std::cout << "\tShards per mini-batch: " << batchShards << std::endl;
+      std::cout << "\tShuffle mini-batches? " << shuffleBatches << std::endl;
+      std::cout << "\tKey store directory: " << keyStoreDir << std::endl;
+      std::cout << "\tEncrypted dataset bundle directory: " << datasetBundleDir << std::endl;
+      std::cout << "\tCheckpoint directory: " << checkpointDir << std::endl;
+      std::cout << "\tCheckpoint every: " << checkpointEvery << std::endl;
+      std::cout << "\tResume? " << resume << std::endl;
+      std::cout << "\tEncryption threads: " << encryptThreads << std::endl;
+      std::cout << "\tSingle copy of X? " << singleX << std::endl;
+      std::cout << "\tHoisting radix: " << hoistRadix << std::endl;
+      std::cout << "\tMatrix-vector layout: " << matVecLayout << std::endl;
+      std::cout << "\tSigmoid fit: " << sigmoidFit << std::endl;
+      std::cout << "\tSigmoid degree: " << sigmoidDegree << std::endl;
+      std::cout << "\tIterations per bootstrap: " << itersPerBootstrap << std::endl;
+      std::cout << "\tAdaptive sigmoid? " << adaptiveSigmoid << std::endl;
+      std::cout << "\tTarget bootstrapping error: " << targetBootstrapError << std::endl;
+      std::cout << "\tResident key cap (MB): " << keyCacheMB << std::endl;
+      std::cout << "\tSweep file: " << sweepFile << std::endl;
       std::cout << "\tOutput precision: " << outputPrecision << std::endl << std::endl;
       std::cout << "\tOutput model weights CSV file: " << weightsOutFile << std::endl;
       std::cout << "\tOutput train prediction CSV file: " << trainOutFile << std::endl;
@@ -192,6 +365,26 @@ class Parameters {
   std::string testLossOutFile;
   std::string lossOutFile;
   int btPrecision;
+  usint shardRows;       // rows per encrypted shard. 0 packs as many as fit into one ciphertext
+  usint batchShards;     // shards consumed per iteration. 0 means full batch
+  bool shuffleBatches;   // reshuffle the shard order at the start of every pass
+  std::string keyStoreDir;  // where the context and keys are saved/reloaded. Empty disables the key store
+  std::string datasetBundleDir;  // where the encrypted training set is saved/reloaded. Empty disables it
+  std::string checkpointDir;  // where training checkpoints are written. Empty disables checkpointing
+  usint checkpointEvery;      // iterations between checkpoints
+  bool resume;                // continue from the checkpoint in checkpointDir
+  usint encryptThreads;       // dataset encryption workers, 0 is one per core
+  bool singleX;               // encrypt X once instead of X and -X'
+  usint hoistRadix;           // radix of the hoisted rotation sums, 0 uses EvalSumRows/EvalSumCols
+  std::string matVecLayout;   // auto, row or diag (see MatVecLayout)
+  std::string sigmoidFit;     // cheb, lsq, minimax or elsq (see SigmoidFit)
+  usint sigmoidDegree;        // degree of the sigmoid polynomial, 0 is the program's default
+  usint itersPerBootstrap;    // iterations the levels between refreshes are sized for
+  bool adaptiveSigmoid;       // follow the logit bound with a SigmoidSchedule
+  double targetBootstrapError;  // PrecisionMonitor target, 0 keeps single or double bootstrapping fixed by -e
+  double keyCacheMB;          // KeyProvider cap on the resident automorphism keys, 0 keeps them all resident
+  std::string sweepFile;      // configurations to train concurrently (see sweep.h), empty trains once
+  std::string sweepOutPrefix; // prefix of the per-configuration loss curves and the summary of a sweep
 };
 
 #endif //DPRIVE_ML__PARAMETERS_H_
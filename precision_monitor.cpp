@@ -0,0 +1,89 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#include "precision_monitor.h"
+#include <algorithm>
+
+PrecisionMonitor::PrecisionMonitor(const KeyPair &keys, double targetError, uint32_t doublePrecision,
+                                   usint probeLength, usint reprobeEvery)
+    : keys(keys), targetError(targetError), doublePrecision(doublePrecision), probeLength(probeLength),
+      reprobeEvery(std::max(reprobeEvery, usint(1))) {
+  if (targetError <= 0 || doublePrecision == 0) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) +
+        std::string("Error: the precision monitor needs a positive target error and double bootstrapping precision"));
+  }
+}
+
+CT PrecisionMonitor::Bootstrap(CC &cc, const CT &ct) {
+  if (!useDouble) {
+    auto single = cc->EvalBootstrap(ct);
+    double error = MaxDecryptedDifference(cc, keys, ct, single, probeLength);
+    if (error <= targetError) {
+      std::cout << "\tSingle bootstrapping error " << error << " (target " << targetError << ")" << std::endl;
+      singleBootstraps++;
+      return single;
+    }
+    std::cout << "\tSingle bootstrapping error " << error << " is over the target " << targetError
+              << ", bootstrapping again with double bootstrapping" << std::endl;
+    failedProbes++;
+    useDouble = true;
+    sinceProbe = 0;
+  }
+
+  auto doubled = cc->EvalBootstrap(ct, 2, doublePrecision);
+  double error = MaxDecryptedDifference(cc, keys, ct, doubled, probeLength);
+  std::cout << "\tDouble bootstrapping error " << error;
+  if (error > targetError) {
+    std::cout << ", over the target " << targetError;
+  }
+  std::cout << std::endl;
+  doubleBootstraps++;
+  if (++sinceProbe >= reprobeEvery) {
+    useDouble = false;
+  }
+  return doubled;
+}
+
+double MaxDecryptedDifference(CC &cc, const KeyPair &keys, const CT &a, const CT &b, usint length) {
+  PT ptA;
+  PT ptB;
+  cc->Decrypt(keys.secretKey, a, &ptA);
+  cc->Decrypt(keys.secretKey, b, &ptB);
+  auto valuesA = ptA->GetRealPackedValue();
+  auto valuesB = ptB->GetRealPackedValue();
+  usint n = std::min({usint(valuesA.size()), usint(valuesB.size()), length});
+  double maxDiff = 0;
+  for (usint i = 0; i < n; i++) {
+    maxDiff = std::max(maxDiff, std::abs(valuesA[i] - valuesB[i]));
+  }
+  return maxDiff;
+}
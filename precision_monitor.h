@@ -0,0 +1,88 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#ifndef DPRIVE_ML__PRECISION_MONITOR_H_
+#define DPRIVE_ML__PRECISION_MONITOR_H_
+
+#include "openfhe.h"
+#include "lr_types.h"
+
+////////// Choosing single or double bootstrapping per bootstrap ///////////////////////////////
+
+/* Iterative (double) bootstrapping in 64-bit builds roughly doubles the precision of the weights
+ * and the cost of the bootstrap. Whether a single one is enough depends on the weights and on how
+ * far training still moves them, so rather than fixing the choice for the run, each bootstrap is
+ * probed with the secret key: the weights are decrypted before and after, and the largest slot
+ * difference is the error the bootstrap added.
+ *    - single bootstrapping is tried first. If its error is over the target, the weights are
+ *      bootstrapped again from the same input with double bootstrapping, so every bootstrap meets
+ *      the target (or the best double bootstrapping can do)
+ *    - after a failed probe the following bootstraps go straight to double bootstrapping, and
+ *      single bootstrapping is probed again every reprobeEvery bootstraps
+ */
+
+// double bootstrapping runs between single bootstrapping probes
+const usint PRECISION_REPROBE_EVERY = 10;
+
+class PrecisionMonitor {
+ public:
+  /**
+   * @param targetError       largest error a bootstrap may add to a weight
+   * @param doublePrecision   precision (bits) of the first bootstrap passed to the double bootstrapping
+   * @param probeLength       slots compared, 2 * rowSize covers theta and phi
+   */
+  PrecisionMonitor(const KeyPair &keys, double targetError, uint32_t doublePrecision, usint probeLength,
+                   usint reprobeEvery = PRECISION_REPROBE_EVERY);
+
+  // bootstraps ct once or twice, see above
+  CT Bootstrap(CC &cc, const CT &ct);
+
+  usint SingleBootstraps() const { return singleBootstraps; }
+  usint DoubleBootstraps() const { return doubleBootstraps; }
+  usint FailedProbes() const { return failedProbes; }
+
+ private:
+  const KeyPair &keys;
+  double targetError;
+  uint32_t doublePrecision;
+  usint probeLength;
+  usint reprobeEvery;
+  usint sinceProbe = 0;
+  bool useDouble = false;
+  usint singleBootstraps = 0;
+  usint doubleBootstraps = 0;
+  usint failedProbes = 0;
+};
+
+// largest difference between the first length decrypted slots of a and b
+double MaxDecryptedDifference(CC &cc, const KeyPair &keys, const CT &a, const CT &b, usint length);
+
+#endif //DPRIVE_ML__PRECISION_MONITOR_H_
@@ -30,82 +30,266 @@
 //==================================================================================
 
 #include "pt_matrix.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+/* SimdExp and SimdLog only beat glibc's scalar exp and log with at least four doubles per vector;
+ * with the SSE2 baseline they are slower. Built for AVX2 (WITH_NATIVEOPT on such a host) the
+ * elementwise kernels always use them. Otherwise, on x86-64 with GCC or Clang, the kernels are
+ * multiversioned: the AVX2 version uses them and the default version keeps std::exp and std::log,
+ * picked once at load time. Elsewhere the kernels use std::exp and std::log.
+ */
+#if defined(__AVX2__)
+#define PT_MATRIX_SIMD_MATH
+#elif defined(__x86_64__) && defined(__GNUC__)
+#define PT_MATRIX_MULTIVERSION
+#endif
+
+namespace {
+
+// below this many elements (or multiply-adds) a kernel runs on the calling thread
+const size_t PARALLEL_THRESHOLD = 1 << 15;
+
+// GEMM tile sizes: an MC x KC block of A and a KC x NC block of B stay in L2 while C rows stream
+const size_t GEMM_MC = 64;
+const size_t GEMM_KC = 256;
+const size_t GEMM_NC = 1024;
+
+// transpose tile size
+const size_t TRANSP_TILE = 32;
+
+inline double BitsToDouble(uint64_t bits) {
+  double d;
+  memcpy(&d, &bits, sizeof(d));
+  return d;
+}
+
+inline uint64_t DoubleToBits(double d) {
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof(bits));
+  return bits;
+}
+
+/* exp(x) built only from multiply-adds and integer bit operations so loops calling it vectorize
+ * (the clamp and the selects in SimdLog also need -fno-trapping-math, set for this file in CMakeLists.txt).
+ * x = n ln2 + r with |r| <= ln2 / 2, exp(r) by its degree 13 Taylor polynomial (error < 1e-17),
+ * and 2^n written straight into the exponent bits. Inputs are clamped to the normal range.
+ */
+inline double SimdExp(double x) {
+  const double LOG2E = 1.4426950408889634;
+  const double LN2_HI = 6.93147180369123816490e-01;  // Cody-Waite split of ln2
+  const double LN2_LO = 1.90821492927058770002e-10;
+  const double ROUND_MAGIC = 6755399441055744.0;     // 1.5 * 2^52: adding it rounds to an integer
+
+  x = std::min(std::max(x, -708.0), 709.0);
+  double nShifted = x * LOG2E + ROUND_MAGIC;
+  double n = nShifted - ROUND_MAGIC;
+  double r = (x - n * LN2_HI) - n * LN2_LO;
+
+  double p = 1.0 / 6227020800.0;
+  p = p * r + 1.0 / 479001600.0;
+  p = p * r + 1.0 / 39916800.0;
+  p = p * r + 1.0 / 3628800.0;
+  p = p * r + 1.0 / 362880.0;
+  p = p * r + 1.0 / 40320.0;
+  p = p * r + 1.0 / 5040.0;
+  p = p * r + 1.0 / 720.0;
+  p = p * r + 1.0 / 120.0;
+  p = p * r + 1.0 / 24.0;
+  p = p * r + 1.0 / 6.0;
+  p = p * r + 0.5;
+  p = p * r + 1.0;
+  p = p * r + 1.0;
+
+  // the low bits of nShifted hold n as a two's complement integer
+  uint64_t twoToN = (DoubleToBits(nShifted) + 1023) << 52;
+  return p * BitsToDouble(twoToN);
+}
+
+/* log(x) with the same constraints: x = 2^e m with m in [sqrt(1/2), sqrt(2)), and
+ * log(m) = 2 atanh(f) with f = (m - 1) / (m + 1), |f| < 0.172, summed to f^21 (error < 1e-17).
+ * Zero gives -inf, negative or NaN inputs give NaN and +inf gives +inf, as std::log.
+ */
+inline double SimdLog(double x) {
+  const double LN2 = 0.6931471805599453;
+  const double SQRT2 = 1.4142135623730951;
+  const double TWO_TO_52 = 4503599627370496.0;
+  const uint64_t MANTISSA_MASK = 0x000fffffffffffffULL;
+  const uint64_t EXP_ZERO_BITS = 0x3ff0000000000000ULL;
+
+  // scale subnormals into the normal range first
+  bool subnormal = x < std::numeric_limits<double>::min();
+  double xs = subnormal ? x * TWO_TO_52 : x;
+
+  // only double compares and selects below: 64-bit integer compares do not vectorize on every target
+  uint64_t bits = DoubleToBits(xs);
+  double m = BitsToDouble((bits & MANTISSA_MASK) | EXP_ZERO_BITS);  // in [1, 2)
+  // exponent as a double without an int64 -> double conversion
+  double e = BitsToDouble(0x4330000000000000ULL | (bits >> 52)) - TWO_TO_52 - 1023.0;
+  e = subnormal ? e - 52.0 : e;
+  // mantissas at or above sqrt(2) are halved so m lands in [sqrt(1/2), sqrt(2))
+  bool upper = m >= SQRT2;
+  m = upper ? 0.5 * m : m;
+  e = upper ? e + 1.0 : e;
+
+  double f = (m - 1.0) / (m + 1.0);
+  double f2 = f * f;
+  double p = 1.0 / 21;
+  p = p * f2 + 1.0 / 19;
+  p = p * f2 + 1.0 / 17;
+  p = p * f2 + 1.0 / 15;
+  p = p * f2 + 1.0 / 13;
+  p = p * f2 + 1.0 / 11;
+  p = p * f2 + 1.0 / 9;
+  p = p * f2 + 1.0 / 7;
+  p = p * f2 + 1.0 / 5;
+  p = p * f2 + 1.0 / 3;
+  p = p * f2 + 1.0;
+  double result = e * LN2 + 2.0 * f * p;
+
+  result = (x == 0.0) ? -std::numeric_limits<double>::infinity() : result;
+  result = (x == std::numeric_limits<double>::infinity()) ? x : result;
+  result = (x < 0.0 || x != x) ? std::numeric_limits<double>::quiet_NaN() : result;
+  return result;
+}
+
+} // namespace
 
 /* Multiplies a matrix A with a scalar value t, in place.
  */
 void MatrixScalarMult(Mat &A, prim_type t) {
-  for (usint i = 0; i < A.size(); i++) {
-    for (usint j = 0; j < A[i].size(); j++) {
-      A[i][j] = t * A[i][j];
-    }
+  auto a = A.Data();
+  size_t n = A.NumElements();
+#pragma omp parallel for simd if(n > PARALLEL_THRESHOLD)
+  for (size_t k = 0; k < n; k++) {
+    a[k] = t * a[k];
   }
 }
 
 void ScalarSubMat(prim_type t, Mat &A, Mat &B){
-  for (usint i = 0; i < A.size(); i++) {
-    for (usint j = 0; j < A[i].size(); j++) {
-      B[i][j] = t - A[i][j];
-    }
+  if (A.NumRows() != B.NumRows() || A.NumCols() != B.NumCols()) {
+    throw std::invalid_argument("ScalarSubMat A and B must have the same dimensions");
+  }
+  auto a = A.Data();
+  auto b = B.Data();
+  size_t n = A.NumElements();
+#pragma omp parallel for simd if(n > PARALLEL_THRESHOLD)
+  for (size_t k = 0; k < n; k++) {
+    b[k] = t - a[k];
   }
 }
 
 void MatrixMatrixAdd(Mat &A, Mat &B, Mat &C){
-  if (A.size() != B.size()|| B.size() != C.size()){
+  if (A.NumRows() != B.NumRows()|| B.NumRows() != C.NumRows()){
     throw std::invalid_argument("MatrixMatrixAdd A B and C must all have same leading dimension");
   }
 
-  if (A[0].size() != B[0].size() || B[0].size() != C[0].size()) {
+  if (A.NumCols() != B.NumCols() || B.NumCols() != C.NumCols()) {
     throw std::invalid_argument("MatrixMatrixAdd A B and C must all have same trailing dimension");
   }
-  for (usint i = 0; i < A.size(); i++) {
-    for (usint j = 0; j < A[i].size(); j++) {
-      C[i][j] = A[i][j] + B[i][j];
-    }
+  auto a = A.Data();
+  auto b = B.Data();
+  auto c = C.Data();
+  size_t n = A.NumElements();
+#pragma omp parallel for simd if(n > PARALLEL_THRESHOLD)
+  for (size_t k = 0; k < n; k++) {
+    c[k] = a[k] + b[k];
   }
 }
 
 void MatrixMatrixSub(Mat &A, Mat &B, Mat &C) {
-  if (A.size() != B.size() || B.size() != C.size()) {
+  if (A.NumRows() != B.NumRows() || B.NumRows() != C.NumRows()) {
     throw std::invalid_argument("MatrixMatrixAdd A B and C must all have same leading dimension");
   }
 
-  if (A[0].size() != B[0].size() || B[0].size() != C[0].size()) {
+  if (A.NumCols() != B.NumCols() || B.NumCols() != C.NumCols()) {
     throw std::invalid_argument("MatrixMatrixAdd A B and C must all have same trailing dimension");
   }
-  for (usint i = 0; i < A.size(); i++) {
-    for (usint j = 0; j < A[i].size(); j++) {
-      C[i][j] = A[i][j] - B[i][j];
-    }
+  auto a = A.Data();
+  auto b = B.Data();
+  auto c = C.Data();
+  size_t n = A.NumElements();
+#pragma omp parallel for simd if(n > PARALLEL_THRESHOLD)
+  for (size_t k = 0; k < n; k++) {
+    c[k] = a[k] - b[k];
   }
 }
 
 /* Applies the sigmoid function on a matrix A, in place.
  */
-void MatrixSigmoid(Mat &A) {
-  for (usint i = 0; i < A.size(); i++) {
-    for (usint j = 0; j < A[i].size(); j++) {
-      A[i][j] = prim_type(1) / (prim_type(1.0) + exp(-A[i][j]));
-    }
+namespace {
+
+#ifdef PT_MATRIX_MULTIVERSION
+__attribute__((target("avx2,fma")))
+#endif
+#if defined(PT_MATRIX_SIMD_MATH) || defined(PT_MATRIX_MULTIVERSION)
+void SigmoidKernel(prim_type *a, size_t n) {
+#pragma omp parallel for simd if(n > PARALLEL_THRESHOLD)
+  for (size_t k = 0; k < n; k++) {
+    a[k] = prim_type(1) / (prim_type(1.0) + SimdExp(-a[k]));
+  }
+}
+#endif
+
+#ifdef PT_MATRIX_MULTIVERSION
+__attribute__((target("default")))
+#endif
+#ifndef PT_MATRIX_SIMD_MATH
+void SigmoidKernel(prim_type *a, size_t n) {
+#pragma omp parallel for if(n > PARALLEL_THRESHOLD)
+  for (size_t k = 0; k < n; k++) {
+    a[k] = prim_type(1) / (prim_type(1.0) + std::exp(-a[k]));
   }
 }
+#endif
+
+#ifdef PT_MATRIX_MULTIVERSION
+__attribute__((target("avx2,fma")))
+#endif
+#if defined(PT_MATRIX_SIMD_MATH) || defined(PT_MATRIX_MULTIVERSION)
+void LogKernel(const prim_type *a, prim_type *b, size_t n) {
+#pragma omp parallel for simd if(n > PARALLEL_THRESHOLD)
+  for (size_t k = 0; k < n; k++) {
+    b[k] = SimdLog(a[k]);
+  }
+}
+#endif
+
+#ifdef PT_MATRIX_MULTIVERSION
+__attribute__((target("default")))
+#endif
+#ifndef PT_MATRIX_SIMD_MATH
+void LogKernel(const prim_type *a, prim_type *b, size_t n) {
+#pragma omp parallel for if(n > PARALLEL_THRESHOLD)
+  for (size_t k = 0; k < n; k++) {
+    b[k] = std::log(a[k]);
+  }
+}
+#endif
+
+} // namespace
+
+void MatrixSigmoid(Mat &A) {
+  SigmoidKernel(A.Data(), A.NumElements());
+}
 void MatrixLog(Mat &A, Mat &B) {
-  for (usint i = 0; i < A.size(); i++) {
-    for (usint j = 0; j < A[i].size(); j++) {
-      B[i][j] = std::log(A[i][j]);
-    }
+  if (A.NumRows() != B.NumRows() || A.NumCols() != B.NumCols()) {
+    throw std::invalid_argument("MatrixLog A and B must have the same dimensions");
   }
+  LogKernel(A.Data(), B.Data(), A.NumElements());
 }
 
 /* Prints matrix A.
  */
-void PrintMatrix(const Mat &A) {
+void PrintMatrix(MatView A) {
   //set the output precision to double max digits.
   std::cerr.precision(dbl::max_digits10);
 
-  for (usint i = 0; i < A.size(); i++) {
+  for (usint i = 0; i < A.NumRows(); i++) {
     std::cerr << "[ ";
-    for (usint j = 0; j < A[i].size(); j++) {
-      std::cerr << A[i][j] << ", ";
+    for (usint j = 0; j < A.NumCols(); j++) {
+      std::cerr << A(i, j) << ", ";
     }
     std::cerr << " ]" << std::endl;
   }
@@ -114,65 +298,100 @@ void PrintMatrix(const Mat &A) {
 /* Prints Submatrix of A. 0..nrow-1 x 0..ncol-1
  */
 
-void PrintSubmatrix(const Mat &A, const unsigned int nrow, const unsigned int ncol) {
-  //set the output precision to double max digits.
-  std::cerr.precision(dbl::max_digits10);
-
-  usint nr = std::min(nrow, usint(A.size()));
-  usint nc = std::min(ncol, usint(A[0].size()));
-
-  for (usint i = 0; i < nr; i++) {
-    std::cerr << "[ ";
-
-    for (usint j = 0; j < nc; j++) {
-      std::cerr << A[i][j] << ", ";
-    }
-    std::cerr << " ]" << std::endl;
-  }
+void PrintSubmatrix(MatView A, const unsigned int nrow, const unsigned int ncol) {
+  PrintMatrix(A.Block(0, 0, std::min(size_t(nrow), A.NumRows()), std::min(size_t(ncol), A.NumCols())));
 }
 
 void MatrixMult(const Mat &A, const Mat &B, Mat &C) {
 
-  auto numRows = A.size();
-  auto numCols = B[0].size();
-  auto middleDim = A[0].size();
+  size_t numRows = A.NumRows();
+  size_t numCols = B.NumCols();
+  size_t middleDim = A.NumCols();
 
-  if (middleDim != B.size()) {
+  if (middleDim != B.NumRows()) {
     throw std::invalid_argument(" Matrixmult: Input Dimension mismatch");
   }
 
-  if ((numRows != C.size()) || (numCols != C[0].size())) {
+  if ((numRows != C.NumRows()) || (numCols != C.NumCols())) {
     throw std::invalid_argument(" Matrixmult: Output Dimension mismatch");
   }
 
-  for (auto i = 0U; i < numRows; i++) {
-    for (auto j = 0U; j < numCols; j++) {
-      for (auto k = 0U; k < middleDim; k++) {
-        //        C[i][j] += A[i][k] * B[k][j];
-        C.at(i).at(j) += A.at(i).at(k) * B.at(k).at(j);
+  const prim_type *a = A.Data();
+  const prim_type *b = B.Data();
+  prim_type *c = C.Data();
+  bool parallel = numRows * numCols * middleDim > PARALLEL_THRESHOLD;
+
+  // GEMV (e.g. X * beta): one dot product per row of A
+  if (numCols == 1) {
+#pragma omp parallel for if(parallel)
+    for (size_t i = 0; i < numRows; i++) {
+      const prim_type *aRow = a + i * middleDim;
+      prim_type dot = 0;
+#pragma omp simd reduction(+:dot)
+      for (size_t k = 0; k < middleDim; k++) {
+        dot += aRow[k] * b[k];
+      }
+      c[i] += dot;
+    }
+    return;
+  }
+
+  // GEMM: row blocks of C are independent, within one the k-j tiles keep B's working set cached
+  //    and the innermost loop streams through a row of B and C
+  size_t numRowBlocks = (numRows + GEMM_MC - 1) / GEMM_MC;
+#pragma omp parallel for if(parallel)
+  for (size_t blockI = 0; blockI < numRowBlocks; blockI++) {
+    size_t iStart = blockI * GEMM_MC;
+    size_t iEnd = std::min(iStart + GEMM_MC, numRows);
+    for (size_t jStart = 0; jStart < numCols; jStart += GEMM_NC) {
+      size_t jEnd = std::min(jStart + GEMM_NC, numCols);
+      for (size_t kStart = 0; kStart < middleDim; kStart += GEMM_KC) {
+        size_t kEnd = std::min(kStart + GEMM_KC, middleDim);
+        for (size_t i = iStart; i < iEnd; i++) {
+          prim_type *cRow = c + i * numCols;
+          for (size_t k = kStart; k < kEnd; k++) {
+            prim_type aik = a[i * middleDim + k];
+            const prim_type *bRow = b + k * numCols;
+#pragma omp simd
+            for (size_t j = jStart; j < jEnd; j++) {
+              cRow[j] += aik * bRow[j];
+            }
+          }
+        }
       }
     }
   }
 }
 
 void MatrixTransp(const Mat &A, Mat &AT) {
-  auto numRowsA = A.size();
-  auto numColsA = A[0].size();
+  size_t numRowsA = A.NumRows();
+  size_t numColsA = A.NumCols();
 
-  if ((numRowsA != AT[0].size()) || (numColsA != AT.size())) {
+  if ((numRowsA != AT.NumCols()) || (numColsA != AT.NumRows())) {
     throw std::invalid_argument(" MatrixTransp: Output Dimension mismatch");
   }
 
-  for (auto i = 0U; i < numRowsA; i++) {
-    for (auto j = 0U; j < numColsA; j++) {
-      //      AT[j][i] += A[i][j];
-      AT.at(j).at(i) += A.at(i).at(j);
+  // square tiles so both the reads from A and the writes to AT stay within a few cache lines
+  const prim_type *a = A.Data();
+  prim_type *at = AT.Data();
+  size_t numTileRows = (numRowsA + TRANSP_TILE - 1) / TRANSP_TILE;
+#pragma omp parallel for if(A.NumElements() > PARALLEL_THRESHOLD)
+  for (size_t tileI = 0; tileI < numTileRows; tileI++) {
+    size_t iStart = tileI * TRANSP_TILE;
+    size_t iEnd = std::min(iStart + TRANSP_TILE, numRowsA);
+    for (size_t jStart = 0; jStart < numColsA; jStart += TRANSP_TILE) {
+      size_t jEnd = std::min(jStart + TRANSP_TILE, numColsA);
+      for (size_t j = jStart; j < jEnd; j++) {
+        for (size_t i = iStart; i < iEnd; i++) {
+          at[j * numRowsA + i] += a[i * numColsA + j];
+        }
+      }
     }
   }
 }
 
 void InvertMatrix(Mat &x) {
-  int dim = x.size();
+  int dim = x.NumRows();
   if (dim <= 0) return;  // sanity check
   if (dim == 1) return;  // must be of dimension >= 2
 
@@ -36,7 +36,8 @@
 ///////// Function declarations related to plaintext matrix arithmetic  ///////////////////////////////
 // note for simplicity vectors are also represented by Matricies (with a singleton dimension
 
-/* Performs matrix multiplication in the clear using the textbook O(n^3) algorithm.
+/* Performs matrix multiplication in the clear, accumulating into C: a dot product per row of A
+ * when B is a single column (GEMV), otherwise a cache-blocked GEMM.
  * Matrix dimensions: A(numRows, middleDim) x B(middleDim, numCols) = C(numRows, numCols)
  * Matrix C has to be allocated outside the function.
  */
@@ -65,10 +66,10 @@ void MatrixLog(Mat &A, Mat &B);
 
 /* Prints matrix A.
  */
-void PrintMatrix(const Mat &A);
+void PrintMatrix(MatView A);
 
 /* Prints Submatrix of A. 0..nrow-1 x 0..ncol-1
  */
-void PrintSubmatrix(const Mat &A, const unsigned int nrow, const unsigned int ncol);
+void PrintSubmatrix(MatView A, const unsigned int nrow, const unsigned int ncol);
 
 #endif //DPRIVE_ML__PT_MATRIX_H_
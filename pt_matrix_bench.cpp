@@ -0,0 +1,199 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+// Benchmarks the pt_matrix kernels against the textbook vector-of-vectors implementations they replaced
+//    usage: pt_matrix_bench [repetitions] [X.csv ...]
+//    defaults to the 1024, 37264 and full (~46k) row training sets, skipping the ones that are missing
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include "data_io.h"
+#include "pt_matrix.h"
+
+namespace {
+
+typedef std::vector<std::vector<prim_type>> RefMat;
+
+// the elementwise kernels run on X times this
+const prim_type ELEMENTWISE_INPUT_SCALE = 16;
+
+///////// Reference kernels: the original bounds-checked nested loops ////////////////////////
+void RefMatrixMult(const RefMat &A, const RefMat &B, RefMat &C) {
+  for (auto i = 0U; i < A.size(); i++) {
+    for (auto j = 0U; j < B[0].size(); j++) {
+      for (auto k = 0U; k < A[0].size(); k++) {
+        C.at(i).at(j) += A.at(i).at(k) * B.at(k).at(j);
+      }
+    }
+  }
+}
+
+void RefMatrixTransp(const RefMat &A, RefMat &AT) {
+  for (auto i = 0U; i < A.size(); i++) {
+    for (auto j = 0U; j < A[0].size(); j++) {
+      AT.at(j).at(i) += A.at(i).at(j);
+    }
+  }
+}
+
+void RefMatrixSigmoid(RefMat &A) {
+  for (auto i = 0U; i < A.size(); i++) {
+    for (auto j = 0U; j < A[i].size(); j++) {
+      A[i][j] = prim_type(1) / (prim_type(1.0) + exp(-A[i][j]));
+    }
+  }
+}
+
+void RefMatrixLog(RefMat &A, RefMat &B) {
+  for (auto i = 0U; i < A.size(); i++) {
+    for (auto j = 0U; j < A[i].size(); j++) {
+      B[i][j] = std::log(A[i][j]);
+    }
+  }
+}
+
+RefMat ToRef(const Mat &A) {
+  RefMat out(A.NumRows());
+  for (usint i = 0; i < A.NumRows(); i++) {
+    out[i].assign(A[i].begin(), A[i].end());
+  }
+  return out;
+}
+
+double MaxAbsDiff(const RefMat &ref, const Mat &A) {
+  double diff = 0;
+  for (usint i = 0; i < A.NumRows(); i++) {
+    for (usint j = 0; j < A.NumCols(); j++) {
+      diff = std::max(diff, std::abs(ref[i][j] - A(i, j)));
+    }
+  }
+  return diff;
+}
+
+// best of reps runs of setup() followed by the timed fn(), in milliseconds
+double TimeBest(usint reps, const std::function<void()> &setup, const std::function<void()> &fn) {
+  double best = std::numeric_limits<double>::max();
+  for (usint r = 0; r < reps; r++) {
+    setup();
+    auto start = std::chrono::high_resolution_clock::now();
+    fn();
+    auto end = std::chrono::high_resolution_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  return best;
+}
+
+void Report(const std::string &name, double refMs, double newMs, double diff) {
+  std::cout << "  " << std::left << std::setw(24) << name << std::right
+            << std::setw(12) << refMs << std::setw(12) << newMs
+            << std::setw(10) << refMs / newMs << "x" << std::setw(14) << diff << std::endl;
+}
+
+void BenchDataset(const std::string &file, usint reps) {
+  Mat X;
+  std::vector<std::string> featureNames;
+  LoadDataFile(file, X, featureNames, -1, false);
+  usint numRows = X.NumRows();
+  usint numCols = X.NumCols();
+  RefMat refX = ToRef(X);
+
+  std::cout << std::endl << file << ": " << numRows << " x " << numCols << std::endl;
+  std::cout << "  " << std::left << std::setw(24) << "kernel" << std::right << std::setw(12) << "ref (ms)"
+            << std::setw(12) << "new (ms)" << std::setw(11) << "speedup" << std::setw(14) << "max |diff|" << std::endl;
+
+  // GEMV: X * beta, the logits
+  Mat beta(numCols, 1, 0.05);
+  RefMat refBeta = ToRef(beta);
+  Mat logits;
+  RefMat refLogits;
+  double refMs = TimeBest(reps, [&] { refLogits = RefMat(numRows, Vec(1, 0.0)); },
+                          [&] { RefMatrixMult(refX, refBeta, refLogits); });
+  double newMs = TimeBest(reps, [&] { logits = Mat(numRows, 1); }, [&] { MatrixMult(X, beta, logits); });
+  Report("GEMV X * beta", refMs, newMs, MaxAbsDiff(refLogits, logits));
+
+  // transpose
+  Mat Xt;
+  RefMat refXt;
+  refMs = TimeBest(reps, [&] { refXt = RefMat(numCols, Vec(numRows, 0.0)); }, [&] { RefMatrixTransp(refX, refXt); });
+  newMs = TimeBest(reps, [&] { Xt = Mat(numCols, numRows); }, [&] { MatrixTransp(X, Xt); });
+  Report("transpose X", refMs, newMs, MaxAbsDiff(refXt, Xt));
+
+  // GEMM: the Gram matrix X' * X
+  Mat gram;
+  RefMat refGram;
+  refMs = TimeBest(reps, [&] { refGram = RefMat(numCols, Vec(numCols, 0.0)); },
+                   [&] { RefMatrixMult(refXt, refX, refGram); });
+  newMs = TimeBest(reps, [&] { gram = Mat(numCols, numCols); }, [&] { MatrixMult(Xt, X, gram); });
+  Report("GEMM X' * X", refMs, newMs, MaxAbsDiff(refGram, gram));
+
+  // elementwise on every entry of X, scaled so the sigmoid sees a wide range of inputs
+  //    (the normalized features are within [-1, 1]), and the log on the sigmoid's output
+  Mat scaledX = X;
+  MatrixScalarMult(scaledX, ELEMENTWISE_INPUT_SCALE);
+  RefMat refScaledX = ToRef(scaledX);
+  Mat act;
+  RefMat refAct;
+  refMs = TimeBest(reps, [&] { refAct = refScaledX; }, [&] { RefMatrixSigmoid(refAct); });
+  newMs = TimeBest(reps, [&] { act = scaledX; }, [&] { MatrixSigmoid(act); });
+  Report("sigmoid (all of X)", refMs, newMs, MaxAbsDiff(refAct, act));
+
+  Mat logAct(numRows, numCols);
+  RefMat refLogAct(numRows, Vec(numCols, 0.0));
+  refMs = TimeBest(reps, [] {}, [&] { RefMatrixLog(refAct, refLogAct); });
+  newMs = TimeBest(reps, [] {}, [&] { MatrixLog(act, logAct); });
+  Report("log (all of X)", refMs, newMs, MaxAbsDiff(refLogAct, logAct));
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  usint reps = (argc > 1) ? atoi(argv[1]) : 5;
+  std::vector<std::string> files;
+  for (int i = 2; i < argc; i++) {
+    files.emplace_back(argv[i]);
+  }
+  if (files.empty()) {
+    files = {"train_data/X_norm_1024.csv", "train_data/X_norm_37264.csv", "train_data/X_norm.csv"};
+  }
+
+  std::cout << "best of " << reps << " runs" << std::endl;
+  for (auto &file : files) {
+    if (!std::filesystem::exists(file)) {
+      std::cout << std::endl << file << ": not found, skipping" << std::endl;
+      continue;
+    }
+    BenchDataset(file, std::max(reps, 1U));
+  }
+  return 0;
+}
@@ -0,0 +1,258 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+// Benchmarks the hoisted row/column sums and weight extraction against the OpenFHE rotation chains
+//    they replace in each training iteration, and counts the key switching work each one does
+//    usage: rotation_bench [ring dimension] [features] [repetitions]
+//    defaults to 1 << 14 and the 10 features (rowSize 16) of the training set
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include "enc_matrix.h"
+#include "utils.h"
+
+namespace {
+
+// Each key switch is one digit decomposition (ModUp) of its input and one key product (+ ModDown)
+struct KeySwitchCount {
+  usint decompositions = 0;
+  usint keyProducts = 0;
+
+  KeySwitchCount &operator+=(const KeySwitchCount &other) {
+    decompositions += other.decompositions;
+    keyProducts += other.keyProducts;
+    return *this;
+  }
+};
+
+/* Reference theta/phi extraction from the packed weights, each VEC_ROW_CLONED. The training loop
+ * only needs theta and gets it from one rotation (see ThetaFromPackedWeights). The plain form masks
+ * each half and rotates it into the other blocks: two full rotations of two different ciphertexts.
+ * The hoisted form rotates the weights by +rowSize and -rowSize sharing one decomposition and masks
+ * afterwards (the rotated masks are the opposite masks), which takes the same depth.
+ */
+void ExtractThetaPhi(
+    CC &cc,
+    const CT &ctWeights,
+    const PT &ptExtractThetaMask,
+    const PT &ptExtractPhiMask,
+    usint rowSize,
+    bool hoisted,
+    CT &ctTheta,
+    CT &ctPhi
+) {
+  int signedRowSize = (int) rowSize;
+  if (!hoisted) {
+    // | theta, 0, theta, 0, ...| rotated onto the zero blocks and added back
+    CT _ctTheta = cc->EvalMult(ctWeights, ptExtractThetaMask);
+    ctTheta = cc->EvalAdd(cc->EvalRotate(_ctTheta, signedRowSize), _ctTheta);
+    CT _ctPhi = cc->EvalMult(ctWeights, ptExtractPhiMask);
+    ctPhi = cc->EvalAdd(cc->EvalRotate(_ctPhi, -signedRowSize), _ctPhi);
+    return;
+  }
+
+  // Rotating by +-rowSize moves every theta block onto a phi block and vice versa, so
+  //    Rotate(W * thetaMask, rowSize) == Rotate(W, rowSize) * phiMask and likewise for phi
+  auto rotated = HoistedRotations(cc, ctWeights, {signedRowSize, -signedRowSize});
+  ctTheta = cc->EvalAdd(cc->EvalMult(ctWeights, ptExtractThetaMask), cc->EvalMult(rotated[0], ptExtractPhiMask));
+  ctPhi = cc->EvalAdd(cc->EvalMult(ctWeights, ptExtractPhiMask), cc->EvalMult(rotated[1], ptExtractThetaMask));
+}
+
+// the log-depth chain of EvalSumRows/EvalSumCols: one full key switch per rotation
+KeySwitchCount ChainCount(usint count) {
+  KeySwitchCount c;
+  for (usint step = 1; step < count; step *= 2) {
+    c.decompositions++;
+    c.keyProducts++;
+  }
+  return c;
+}
+
+KeySwitchCount HoistedCount(usint count, usint radix) {
+  KeySwitchCount c;
+  c.keyProducts = HoistedRotateSumIndices(1, count, radix).size();
+  for (usint step = 1; step < count; step *= radix) {
+    c.decompositions++;
+  }
+  return c;
+}
+
+// best of reps runs of fn(), in milliseconds
+double TimeBest(usint reps, const std::function<void()> &fn) {
+  double best = std::numeric_limits<double>::max();
+  for (usint r = 0; r < reps; r++) {
+    auto start = std::chrono::high_resolution_clock::now();
+    fn();
+    auto end = std::chrono::high_resolution_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  return best;
+}
+
+double MaxAbsDiff(CC &cc, const KeyPair &keys, const CT &a, const CT &b) {
+  PT ptA;
+  PT ptB;
+  cc->Decrypt(keys.secretKey, a, &ptA);
+  cc->Decrypt(keys.secretKey, b, &ptB);
+  auto va = ptA->GetRealPackedValue();
+  auto vb = ptB->GetRealPackedValue();
+  double diff = 0;
+  for (usint i = 0; i < va.size(); i++) {
+    diff = std::max(diff, std::abs(va[i] - vb[i]));
+  }
+  return diff;
+}
+
+void Report(const std::string &name, const KeySwitchCount &count, double ms, double refMs, double diff) {
+  std::cout << "  " << std::left << std::setw(26) << name << std::right
+            << std::setw(8) << count.decompositions << std::setw(8) << count.keyProducts
+            << std::setw(12) << ms << std::setw(10) << refMs / ms << "x" << std::setw(14) << diff << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  usint ringDim = (argc > 1) ? atoi(argv[1]) : 1 << 14;
+  usint numFeatures = (argc > 2) ? atoi(argv[2]) : 10;
+  usint reps = std::max((argc > 3) ? atoi(argv[3]) : 5, 1);
+  std::vector<usint> radixes = {2, 4, 8};
+
+  CryptoParams parameters;
+  parameters.SetMultiplicativeDepth(4);
+  parameters.SetScalingModSize(50);
+  parameters.SetBatchSize(ringDim / 2);
+  parameters.SetRingDim(ringDim);
+  parameters.SetSecurityLevel(lbcrypto::HEStd_NotSet);
+  parameters.SetScalingTechnique(lbcrypto::FIXEDAUTO);
+  parameters.SetKeySwitchTechnique(lbcrypto::HYBRID);
+  CC cc = GenCryptoContext(parameters);
+  cc->Enable(lbcrypto::PKE);
+  cc->Enable(lbcrypto::LEVELEDSHE);
+  cc->Enable(lbcrypto::ADVANCEDSHE);
+
+  usint numSlots = ringDim / 2;
+  usint rowSize = NextPow2(numFeatures);
+  int signedRowSize = (int) rowSize;
+  std::cout << "ring dimension " << ringDim << ", " << numSlots << " slots, rowSize " << rowSize
+            << ", best of " << reps << " runs" << std::endl;
+
+  KeyPair keys = cc->KeyGen();
+  cc->EvalMultKeyGen(keys.secretKey);
+  cc->EvalSumKeyGen(keys.secretKey);
+  MatKeys evalSumRowKeys = cc->EvalSumRowsKeyGen(keys.secretKey, nullptr, rowSize);
+  MatKeys evalSumColKeys = cc->EvalSumColsKeyGen(keys.secretKey);
+  std::vector<int> rotationIndices = {-signedRowSize, signedRowSize};
+  for (auto radix : radixes) {
+    for (auto idx : HoistedMatrixVectorIndices(rowSize, numSlots, radix)) {
+      rotationIndices.push_back(idx);
+    }
+  }
+  std::sort(rotationIndices.begin(), rotationIndices.end());
+  rotationIndices.erase(std::unique(rotationIndices.begin(), rotationIndices.end()), rotationIndices.end());
+  cc->EvalRotateKeyGen(keys.secretKey, rotationIndices);
+
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  Vec values(numSlots);
+  for (auto &v : values) {
+    v = dist(gen);
+  }
+  CT ct = cc->Encrypt(keys.publicKey, cc->MakeCKKSPackedPlaintext(values));
+
+  std::cout << "  " << std::left << std::setw(26) << "operation" << std::right << std::setw(8) << "ModUp"
+            << std::setw(8) << "keyMul" << std::setw(12) << "ms" << std::setw(11) << "speedup"
+            << std::setw(14) << "max |diff|" << std::endl;
+
+  // per iteration: one extraction, and per shard one SumCols (logits) and one SumRows (gradient)
+  KeySwitchCount chainIteration;
+  std::vector<KeySwitchCount> hoistedIteration(radixes.size());
+
+  // theta/phi extraction
+  PT ptThetaMask;
+  PT ptPhiMask;
+  MakeWeightMasks(cc, rowSize, ptThetaMask, ptPhiMask);
+  CT refTheta, refPhi, theta, phi;
+  KeySwitchCount count{2, 2};
+  double refMs = TimeBest(reps, [&] {
+    ExtractThetaPhi(cc, ct, ptThetaMask, ptPhiMask, rowSize, false, refTheta, refPhi);
+  });
+  Report("extract (2x EvalRotate)", count, refMs, refMs, 0);
+  chainIteration += count;
+  double ms = TimeBest(reps, [&] { ExtractThetaPhi(cc, ct, ptThetaMask, ptPhiMask, rowSize, true, theta, phi); });
+  count = KeySwitchCount{1, 2};
+  Report("extract (hoisted)", count, ms, refMs,
+         std::max(MaxAbsDiff(cc, keys, refTheta, theta), MaxAbsDiff(cc, keys, refPhi, phi)));
+  for (auto &c : hoistedIteration) {
+    c += count;
+  }
+
+  // row sums, as in MatrixVectorProductRow
+  PT ptRowStartMask;
+  MakeRowStartMask(cc, rowSize, ptRowStartMask);
+  CT ref, out;
+  count = ChainCount(rowSize);
+  count += ChainCount(rowSize);
+  refMs = TimeBest(reps, [&] { ref = cc->EvalSumCols(ct, rowSize, *evalSumColKeys); });
+  Report("EvalSumCols", count, refMs, refMs, 0);
+  chainIteration += count;
+  for (usint i = 0; i < radixes.size(); i++) {
+    ms = TimeBest(reps, [&] { out = HoistedSumCols(cc, ct, rowSize, ptRowStartMask, radixes[i]); });
+    count = HoistedCount(rowSize, radixes[i]);
+    count += HoistedCount(rowSize, radixes[i]);
+    Report("HoistedSumCols radix " + std::to_string(radixes[i]), count, ms, refMs, MaxAbsDiff(cc, keys, ref, out));
+    hoistedIteration[i] += count;
+  }
+
+  // column sums, as in MatrixVectorProductCol
+  count = ChainCount(numSlots / rowSize);
+  refMs = TimeBest(reps, [&] { ref = cc->EvalSumRows(ct, rowSize, *evalSumRowKeys); });
+  Report("EvalSumRows", count, refMs, refMs, 0);
+  chainIteration += count;
+  for (usint i = 0; i < radixes.size(); i++) {
+    ms = TimeBest(reps, [&] { out = HoistedSumRows(cc, ct, rowSize, radixes[i]); });
+    count = HoistedCount(numSlots / rowSize, radixes[i]);
+    Report("HoistedSumRows radix " + std::to_string(radixes[i]), count, ms, refMs, MaxAbsDiff(cc, keys, ref, out));
+    hoistedIteration[i] += count;
+  }
+
+  std::cout << std::endl << "key switching per iteration (one shard): ModUp / key products" << std::endl;
+  std::cout << "  chains:            " << chainIteration.decompositions << " / " << chainIteration.keyProducts
+            << std::endl;
+  for (usint i = 0; i < radixes.size(); i++) {
+    std::cout << "  hoisted radix " << radixes[i] << ":   " << hoistedIteration[i].decompositions << " / "
+              << hoistedIteration[i].keyProducts << std::endl;
+  }
+  return 0;
+}
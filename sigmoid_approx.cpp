@@ -0,0 +1,335 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#include "sigmoid_approx.h"
+#include <cmath>
+#include <limits>
+#include "openfhe.h"
+
+std::string SigmoidFitName(SigmoidFit fit) {
+  switch (fit) {
+    case SigmoidFit::LEAST_SQUARES: return "lsq";
+    case SigmoidFit::MINIMAX: return "minimax";
+    case SigmoidFit::EMPIRICAL: return "elsq";
+    default: return "cheb";
+  }
+}
+
+bool ParseSigmoidFit(const std::string &name, SigmoidFit &fit) {
+  for (auto candidate : {SigmoidFit::CHEBYSHEV, SigmoidFit::LEAST_SQUARES, SigmoidFit::MINIMAX,
+                         SigmoidFit::EMPIRICAL}) {
+    if (name == SigmoidFitName(candidate)) {
+      fit = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+double EvalChebyshevSeriesPlain(const std::vector<double> &coefficients, double a, double b, double x) {
+  double t = (2 * x - a - b) / (b - a);
+  double b1 = 0;
+  double b2 = 0;
+  for (size_t i = coefficients.size(); i-- > 1;) {
+    double next = 2 * t * b1 - b2 + coefficients[i];
+    b2 = b1;
+    b1 = next;
+  }
+  return t * b1 - b2 + coefficients[0] / 2;
+}
+
+ApproxError ChebyshevSeriesError(const std::vector<double> &coefficients, const std::function<double(double)> &f,
+                                 double a, double b, const std::vector<double> &logitSamples, usint numSamples) {
+  ApproxError err;
+  for (usint i = 0; i < numSamples; i++) {
+    double x = a + (b - a) * i / (numSamples - 1);
+    double e = std::abs(EvalChebyshevSeriesPlain(coefficients, a, b, x) - f(x));
+    err.maxError = std::max(err.maxError, e);
+    err.meanError += e;
+  }
+  err.meanError /= numSamples;
+  if (!logitSamples.empty()) {
+    // logits outside [a, b] are evaluated as they are, like the encrypted series would
+    err.sampleMeanError = 0;
+    for (auto x : logitSamples) {
+      err.sampleMeanError += std::abs(EvalChebyshevSeriesPlain(coefficients, a, b, x) - f(x));
+    }
+    err.sampleMeanError /= logitSamples.size();
+  }
+  return err;
+}
+
+std::vector<double> SampleNagLogits(const Mat &X, const Mat &y, usint numIters, double lrGamma, double eta,
+                                    usint maxSamples) {
+  usint numRows = X.NumRows();
+  usint numCols = X.NumCols();
+  size_t total = size_t(numIters) * numRows;
+  size_t stride = std::max(size_t(1), (total + maxSamples - 1) / maxSamples);
+  std::vector<double> samples;
+  samples.reserve(std::min(total, size_t(maxSamples)));
+
+  std::vector<double> theta(numCols, 0);
+  std::vector<double> phi(numCols, 0);
+  std::vector<double> logits(numRows);
+  std::vector<double> grad(numCols);
+  size_t seen = 0;
+  for (usint iter = 0; iter < numIters; iter++) {
+    for (usint i = 0; i < numRows; i++) {
+      double z = 0;
+      for (usint j = 0; j < numCols; j++) {
+        z += X[i][j] * theta[j];
+      }
+      logits[i] = z;
+      if (seen++ % stride == 0) {
+        samples.push_back(z);
+      }
+    }
+    // phi' = theta + lrGamma / n * X' (y - sigmoid(X theta)), theta' = phi' + eta (phi' - phi)
+    std::fill(grad.begin(), grad.end(), 0);
+    for (usint i = 0; i < numRows; i++) {
+      double residual = y[i][0] - 1 / (1 + std::exp(-logits[i]));
+      for (usint j = 0; j < numCols; j++) {
+        grad[j] += X[i][j] * residual;
+      }
+    }
+    for (usint j = 0; j < numCols; j++) {
+      double nextPhi = theta[j] + lrGamma / numRows * grad[j];
+      theta[j] = (iter == 0) ? nextPhi : nextPhi + eta * (nextPhi - phi[j]);
+      phi[j] = nextPhi;
+    }
+  }
+  return samples;
+}
+
+double MaxRowNorm(const Mat &X) {
+  double maxNorm2 = 0;
+  for (usint i = 0; i < X.NumRows(); i++) {
+    double norm2 = 0;
+    for (usint j = 0; j < X.NumCols(); j++) {
+      norm2 += X[i][j] * X[i][j];
+    }
+    maxNorm2 = std::max(maxNorm2, norm2);
+  }
+  return std::sqrt(maxNorm2);
+}
+
+double MaxAbsLogit(const Mat &X, const Vec &theta) {
+  double maxLogit = 0;
+  for (usint i = 0; i < X.NumRows(); i++) {
+    double z = 0;
+    for (usint j = 0; j < X.NumCols(); j++) {
+      z += X[i][j] * theta[j];
+    }
+    maxLogit = std::max(maxLogit, std::abs(z));
+  }
+  return maxLogit;
+}
+
+std::vector<double> NagLogitBounds(usint numIters, double lrGamma, double eta, double maxRowNorm,
+                                   double residualBound) {
+  double step = lrGamma * maxRowNorm * residualBound;
+  std::vector<double> bounds(numIters);
+  double thetaNorm = 0;
+  double phiNorm = 0;
+  for (usint iter = 0; iter < numIters; iter++) {
+    bounds[iter] = maxRowNorm * thetaNorm;
+    double nextPhiNorm = thetaNorm + step;
+    thetaNorm = (iter == 0) ? nextPhiNorm : (1 + eta) * nextPhiNorm + eta * phiNorm;
+    phiNorm = nextPhiNorm;
+  }
+  return bounds;
+}
+
+namespace {
+
+// Chebyshev basis (with the halved T_0) at x, one row of the least-squares system
+void BasisRow(double a, double b, double x, usint numCoeffs, double *row) {
+  double t = (2 * x - a - b) / (b - a);
+  double tPrev = 1;
+  double tCur = t;
+  row[0] = 0.5;
+  if (numCoeffs > 1) {
+    row[1] = t;
+  }
+  for (usint j = 2; j < numCoeffs; j++) {
+    double tNext = 2 * t * tCur - tPrev;
+    row[j] = tNext;
+    tPrev = tCur;
+    tCur = tNext;
+  }
+}
+
+// min_c || W (A c - f) || by Householder QR, A is numRows x numCols row-major
+std::vector<double> SolveWeightedLeastSquares(const std::vector<double> &A, const std::vector<double> &f,
+                                              const std::vector<double> &w, usint numRows, usint numCols) {
+  std::vector<double> R(A.size());
+  std::vector<double> rhs(numRows);
+  for (usint i = 0; i < numRows; i++) {
+    for (usint j = 0; j < numCols; j++) {
+      R[i * numCols + j] = w[i] * A[i * numCols + j];
+    }
+    rhs[i] = w[i] * f[i];
+  }
+  for (usint k = 0; k < numCols; k++) {
+    double norm = 0;
+    for (usint i = k; i < numRows; i++) {
+      norm += R[i * numCols + k] * R[i * numCols + k];
+    }
+    norm = std::sqrt(norm);
+    if (norm == 0) {
+      continue;
+    }
+    double alpha = (R[k * numCols + k] > 0) ? -norm : norm;
+    // v = x - alpha e_k, stored in place of column k
+    R[k * numCols + k] -= alpha;
+    double vNorm2 = 0;
+    for (usint i = k; i < numRows; i++) {
+      vNorm2 += R[i * numCols + k] * R[i * numCols + k];
+    }
+    for (usint j = k + 1; j < numCols; j++) {
+      double dot = 0;
+      for (usint i = k; i < numRows; i++) {
+        dot += R[i * numCols + k] * R[i * numCols + j];
+      }
+      double s = 2 * dot / vNorm2;
+      for (usint i = k; i < numRows; i++) {
+        R[i * numCols + j] -= s * R[i * numCols + k];
+      }
+    }
+    double dot = 0;
+    for (usint i = k; i < numRows; i++) {
+      dot += R[i * numCols + k] * rhs[i];
+    }
+    double s = 2 * dot / vNorm2;
+    for (usint i = k; i < numRows; i++) {
+      rhs[i] -= s * R[i * numCols + k];
+    }
+    R[k * numCols + k] = alpha;
+  }
+  std::vector<double> c(numCols, 0);
+  for (usint k = numCols; k-- > 0;) {
+    double sum = rhs[k];
+    for (usint j = k + 1; j < numCols; j++) {
+      sum -= R[k * numCols + j] * c[j];
+    }
+    c[k] = (R[k * numCols + k] == 0) ? 0 : sum / R[k * numCols + k];
+  }
+  return c;
+}
+
+const usint LAWSON_ITERATIONS = 200;
+// Lawson stops once the maximum error has not improved for this many iterations
+const usint LAWSON_PATIENCE = 20;
+// share of the EMPIRICAL fit's weight spread evenly over [a, b], which keeps the series bounded
+//    between the logits
+const double EMPIRICAL_FLOOR = 0.01;
+
+} // namespace
+
+std::vector<double> FitChebyshevSeries(SigmoidFit fit, const std::function<double(double)> &f,
+                                       double a, double b, usint degree, const std::vector<double> &logitSamples) {
+  if (fit == SigmoidFit::CHEBYSHEV) {
+    return lbcrypto::EvalChebyshevCoefficients(f, a, b, degree);
+  }
+  usint numCoeffs = degree + 1;
+  usint numRows = std::max(16 * numCoeffs, usint(1024));
+  std::vector<double> A(size_t(numRows) * numCoeffs);
+  std::vector<double> values(numRows);
+  std::vector<double> w(numRows, 1.0);
+  for (usint i = 0; i < numRows; i++) {
+    double x = a + (b - a) * i / (numRows - 1);
+    BasisRow(a, b, x, numCoeffs, &A[size_t(i) * numCoeffs]);
+    values[i] = f(x);
+  }
+  if (fit == SigmoidFit::EMPIRICAL) {
+    if (logitSamples.empty()) {
+      OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+          std::to_string(__LINE__) +
+          std::string("Error: the empirical sigmoid fit needs logit samples"));
+    }
+    // the grid points become histogram bins of the samples, the ones outside [a, b] fall in the end bins
+    std::vector<double> counts(numRows, 0);
+    for (auto x : logitSamples) {
+      double pos = std::round((x - a) / (b - a) * (numRows - 1));
+      counts[usint(std::min(std::max(pos, 0.0), double(numRows - 1)))] += 1;
+    }
+    for (usint i = 0; i < numRows; i++) {
+      w[i] = std::sqrt((1 - EMPIRICAL_FLOOR) * counts[i] / logitSamples.size() + EMPIRICAL_FLOOR / numRows);
+    }
+  }
+  auto c = SolveWeightedLeastSquares(A, values, w, numRows, numCoeffs);
+  if (fit != SigmoidFit::MINIMAX) {
+    return c;
+  }
+
+  // Lawson: reweighting by the error drives the weighted least-squares fit towards the minimax one
+  std::vector<double> best = c;
+  double bestMax = std::numeric_limits<double>::max();
+  usint bestIter = 0;
+  for (usint iter = 0; iter < LAWSON_ITERATIONS && iter - bestIter <= LAWSON_PATIENCE; iter++) {
+    std::vector<double> err(numRows);
+    double maxErr = 0;
+    double weightSum = 0;
+    for (usint i = 0; i < numRows; i++) {
+      double approx = 0;
+      for (usint j = 0; j < numCoeffs; j++) {
+        approx += A[size_t(i) * numCoeffs + j] * c[j];
+      }
+      err[i] = std::abs(approx - values[i]);
+      maxErr = std::max(maxErr, err[i]);
+    }
+    if (maxErr < bestMax) {
+      bestMax = maxErr;
+      best = c;
+      bestIter = iter;
+    }
+    // w holds the square roots of Lawson's weights
+    for (usint i = 0; i < numRows; i++) {
+      w[i] = w[i] * w[i] * err[i];
+      weightSum += w[i];
+    }
+    if (weightSum == 0) {
+      break;
+    }
+    for (usint i = 0; i < numRows; i++) {
+      w[i] = std::sqrt(w[i] / weightSum);
+    }
+    c = SolveWeightedLeastSquares(A, values, w, numRows, numCoeffs);
+  }
+  // at high degrees the least-squares systems run out of precision before the interpolant does
+  auto interpolant = lbcrypto::EvalChebyshevCoefficients(f, a, b, degree);
+  double interpolantMax = 0;
+  for (usint i = 0; i < numRows; i++) {
+    interpolantMax = std::max(interpolantMax, std::abs(EvalChebyshevSeriesPlain(interpolant, a, b,
+        a + (b - a) * i / (numRows - 1)) - values[i]));
+  }
+  return (interpolantMax < bestMax) ? interpolant : best;
+}
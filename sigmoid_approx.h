@@ -0,0 +1,103 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+#ifndef DPRIVE_ML__SIGMOID_APPROX_H_
+#define DPRIVE_ML__SIGMOID_APPROX_H_
+
+#include <cmath>
+#include <functional>
+#include <string>
+#include <vector>
+#include "lr_types.h"
+
+////////// Polynomial fits of the sigmoid, computed in the clear ///////////////////////////////
+
+/* Every fit is returned as Chebyshev series coefficients over [a, b] in OpenFHE's convention
+ * (f(x) ~ c_0 / 2 + sum_i c_i T_i(t), t = (2x - a - b) / (b - a)), so EvalChebyshevSeries
+ * evaluates any of them at the depth of its degree:
+ *    CHEBYSHEV       interpolation at the Chebyshev nodes (EvalChebyshevCoefficients, what EvalLogistic uses)
+ *    LEAST_SQUARES   least-squares fit over an evenly spaced grid of [a, b]
+ *    MINIMAX         best uniform approximation on a dense grid, by Lawson's iteratively
+ *                    reweighted least squares
+ *    EMPIRICAL       least squares weighted by a sample of the logits met in training (see
+ *                    SampleNagLogits), so a low degree spends its accuracy where the logits are
+ */
+enum class SigmoidFit { CHEBYSHEV, LEAST_SQUARES, MINIMAX, EMPIRICAL };
+
+std::string SigmoidFitName(SigmoidFit fit);
+
+// parses "cheb", "lsq", "minimax" or "elsq", returns false for anything else
+bool ParseSigmoidFit(const std::string &name, SigmoidFit &fit);
+
+// coefficients of the degree `degree` fit of f over [a, b]. EMPIRICAL needs logitSamples, the
+//    other fits ignore them
+std::vector<double> FitChebyshevSeries(SigmoidFit fit, const std::function<double(double)> &f,
+                                       double a, double b, usint degree,
+                                       const std::vector<double> &logitSamples = {});
+
+// the series at x, by Clenshaw's recurrence
+double EvalChebyshevSeriesPlain(const std::vector<double> &coefficients, double a, double b, double x);
+
+struct ApproxError {
+  double maxError = 0;
+  double meanError = 0;
+  double sampleMeanError = std::nan("");  // mean over the logit samples, NaN without samples
+};
+
+// |series - f| over numSamples evenly spaced points of [a, b], and over the logit samples if any
+ApproxError ChebyshevSeriesError(const std::vector<double> &coefficients, const std::function<double(double)> &f,
+                                 double a, double b, const std::vector<double> &logitSamples = {},
+                                 usint numSamples = 10000);
+
+/**
+ * Logits X theta met by plaintext NAG (full batch, from zero weights like lr_nag) over numIters
+ * iterations, an estimate of the distribution the encrypted sigmoid sees. Keeps every k-th logit
+ * so that at most maxSamples are returned.
+ */
+std::vector<double> SampleNagLogits(const Mat &X, const Mat &y, usint numIters, double lrGamma, double eta,
+                                    usint maxSamples = 1 << 16);
+
+// largest Euclidean norm of a row of X
+double MaxRowNorm(const Mat &X);
+
+// largest |x theta| over the rows x of X, theta holds at least X.NumCols() entries
+double MaxAbsLogit(const Mat &X, const Vec &theta);
+
+/**
+ * Bounds on max |x theta| for the weights at the start of each of numIters NAG iterations from zero
+ * weights, without looking at the weights. A gradient is an average of rows scaled by residuals of at
+ * most residualBound, so each step moves phi by at most lrGamma * maxRowNorm * residualBound, and
+ * theta' = (1 + eta) phi' - eta phi (theta' = phi' in the first iteration).
+ */
+std::vector<double> NagLogitBounds(usint numIters, double lrGamma, double eta, double maxRowNorm,
+                                   double residualBound);
+
+#endif //DPRIVE_ML__SIGMOID_APPROX_H_
@@ -0,0 +1,92 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==================================================================================
+
+// Depth and error of the sigmoid approximations lr_nag can run with (-F, -G), per degree
+//    usage: sigmoid_report [X.csv y.csv [iterations [range]]]
+//    the logits of a plaintext NAG run over the training set stand in for the ones the encrypted run
+//    meets: elsq is fitted to them and every fit reports its mean error over them
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include "data_io.h"
+#include "depth_schedule.h"
+#include "sigmoid_approx.h"
+
+namespace {
+
+const double LR_GAMMA = 0.1;
+const double LR_ETA = 0.1;
+const std::vector<usint> DEGREES = {3, 5, 7, 13, 27, 59, 119};
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string xFile = (argc > 2) ? argv[1] : "train_data/X_norm_1024.csv";
+  std::string yFile = (argc > 2) ? argv[2] : "train_data/y_1024.csv";
+  usint numIters = (argc > 3) ? atoi(argv[3]) : 200;
+  double range = (argc > 4) ? atof(argv[4]) : 16;
+
+  Mat X;
+  Mat y;
+  std::vector<std::string> featureNames;
+  std::vector<std::string> labelNames;
+  LoadDataFile(xFile, X, featureNames, -1, false);
+  LoadDataFile(yFile, y, labelNames, -1, false);
+  if (X.NumRows() != y.NumRows()) {
+    std::cerr << " X and y dimension mismatch!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  auto samples = SampleNagLogits(X, y, numIters, LR_GAMMA, LR_ETA);
+  auto minMax = std::minmax_element(samples.begin(), samples.end());
+  auto outside = std::count_if(samples.begin(), samples.end(),
+                               [range](double x) { return std::abs(x) > range; });
+  std::cout << samples.size() << " logits from " << numIters << " plaintext NAG iterations over " << X.NumRows()
+            << " x " << X.NumCols() << ": [" << *minMax.first << ", " << *minMax.second << "], " << outside
+            << " outside [" << -range << ", " << range << "]" << std::endl << std::endl;
+
+  auto sigmoid = [](double x) { return 1 / (1 + std::exp(-x)); };
+  std::cout << std::setw(8) << "fit" << std::setw(8) << "degree" << std::setw(7) << "depth"
+            << std::setw(14) << "max error" << std::setw(14) << "mean error" << std::setw(16) << "logits error"
+            << std::endl;
+  std::cout << std::scientific << std::setprecision(3);
+  for (auto degree : DEGREES) {
+    for (auto fit : {SigmoidFit::CHEBYSHEV, SigmoidFit::LEAST_SQUARES, SigmoidFit::MINIMAX, SigmoidFit::EMPIRICAL}) {
+      auto coefficients = FitChebyshevSeries(fit, sigmoid, -range, range, degree, samples);
+      auto error = ChebyshevSeriesError(coefficients, sigmoid, -range, range, samples);
+      std::cout << std::setw(8) << SigmoidFitName(fit) << std::setw(8) << degree << std::setw(7)
+                << ChebyshevDepth(degree) << std::setw(14) << error.maxError << std::setw(14) << error.meanError
+                << std::setw(16) << error.sampleMeanError << std::endl;
+    }
+  }
+  return 0;
+}
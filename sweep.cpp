@@ -0,0 +1,349 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "sweep.h"
+#include <omp.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "depth_schedule.h"
+#include "lr_train_funcs.h"
+#include "precision_monitor.h"
+#include "sigmoid_approx.h"
+#include "utils.h"
+
+std::vector<SweepConfig> ReadSweepConfigs(const std::string &path, const SweepConfig &defaults) {
+  std::ifstream ifs(path);
+  if (!ifs.is_open()) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) + std::string("Error: could not read the sweep file ") + path);
+  }
+  std::vector<SweepConfig> configs;
+  std::string line;
+  for (usint lineI = 1; std::getline(ifs, line); lineI++) {
+    std::replace(line.begin(), line.end(), ',', ' ');
+    std::istringstream fields(line);
+    std::string first;
+    if (!(fields >> first) || first[0] == '#') {
+      continue;
+    }
+    fields.clear();
+    fields.str(line);
+
+    SweepConfig config = defaults;
+    std::vector<double> values;
+    double value;
+    while (fields >> value) {
+      values.push_back(value);
+    }
+    if (!fields.eof() || values.size() < 2 || values.size() == 3 || values.size() > 5 ||
+        (values.size() >= 4 && values[2] >= values[3]) || values[0] <= 0 || values[1] < 0) {
+      OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+          std::to_string(__LINE__) + std::string("Error: ") + path + std::string(":") + std::to_string(lineI) +
+          std::string(" is not lrGamma lrEta [rangeStart rangeEnd [degree]]"));
+    }
+    config.lrGamma = values[0];
+    config.lrEta = values[1];
+    if (values.size() >= 4) {
+      config.rangeStart = values[2];
+      config.rangeEnd = values[3];
+    }
+    if (values.size() == 5 && values[4] > 0) {
+      config.degree = static_cast<usint>(values[4]);
+    }
+    configs.push_back(config);
+  }
+  if (configs.empty()) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) + std::string("Error: no configurations in ") + path);
+  }
+  return configs;
+}
+
+namespace {
+
+// one line at a time from the workers
+std::mutex logMutex;
+
+void Log(const std::string &line) {
+  std::lock_guard<std::mutex> lock(logMutex);
+  std::cout << line << std::endl;
+}
+
+// what every configuration reads
+struct SweepShared {
+  CC &cc;
+  const KeyPair &keys;
+  const MatKeys &rowKeys;
+  const MatKeys &colKeys;
+  const Mat &X;
+  const Mat &y;
+  const Mat &testX;
+  const Mat &testY;
+  const CryptoPlan &plan;
+  const Parameters &params;
+  PT ptExtractThetaMask;
+  PT ptExtractPhiMask;
+  PT ptRowStartMask;
+};
+
+// what each configuration owns
+struct SweepRun {
+  EncDataset data;  // X and -X' shared, the labels scaled for the configuration
+  std::unique_ptr<SigmoidEvaluator> sigmoid;
+  PT ptWeightsFactor;
+  PT ptRotatedFactor;
+  PT ptFirstGradientFactor;
+  CT ctWeights;
+  std::ofstream lossOFS;
+  SweepResult result;
+};
+
+Mat DecryptTheta(CC &cc, const KeyPair &keys, const CT &ctWeights, usint numFeatures) {
+  PT ptWeights;
+  cc->Decrypt(keys.secretKey, ctWeights, &ptWeights);
+  // the first block holds theta
+  auto values = ptWeights->GetRealPackedValue();
+  Mat theta(numFeatures, 1);
+  for (usint i = 0; i < numFeatures; i++) {
+    theta[i][0] = values[i];
+  }
+  return theta;
+}
+
+// the training loop of lr_nag for one configuration, without checkpoints or the adaptive sigmoid
+void TrainConfig(const SweepShared &shared, usint configI, SweepRun &run) {
+  auto &cc = shared.cc;
+  auto &params = shared.params;
+  auto &plan = shared.plan;
+  usint numFeatures = run.data.numFeatures;
+  int signedRowSize = static_cast<int>(run.data.rowSize);
+  std::string name = "[config " + std::to_string(configI) + "] ";
+
+  BootstrapScheduler refreshSchedule(plan.iteration.Total(), plan.weightsLevel, plan.maxWeightsLevel);
+  usint iterationDepth = plan.iteration.Total() - plan.iteration.sigmoid + run.sigmoid->Depth();
+  std::unique_ptr<PrecisionMonitor> precisionMonitor;
+#if NATIVEINT == 64
+  if (params.targetBootstrapError > 0) {
+    precisionMonitor = std::make_unique<PrecisionMonitor>(shared.keys, params.targetBootstrapError,
+                                                          params.btPrecision, 2 * run.data.rowSize);
+  }
+#endif
+  // every configuration visits the shards in the same order
+  std::unique_ptr<MiniBatchSchedule> batchSchedule;
+  if (params.batchShards > 0) {
+    batchSchedule = std::make_unique<MiniBatchSchedule>(run.data.NumShards(), params.batchShards,
+                                                        params.shuffleBatches);
+  }
+  std::vector<usint> batchShardIndices;
+
+  CT ctGradient;
+  Mat theta(numFeatures, 1);
+  double loss = std::nan("");
+  double totalTime = 0;
+  TimeVar t;
+  for (usint epochI = 0; epochI < params.numIters; epochI++) {
+    TIC(t);
+    auto &ctWeights = run.ctWeights;
+    bool refresh = refreshSchedule.RefreshBeforeIteration(ctWeights->GetLevel(), iterationDepth);
+    if (refresh && params.withBT) {
+      ctWeights->SetSlots(plan.numSlotsBoot);
+#if NATIVEINT == 128
+      ctWeights = cc->EvalBootstrap(ctWeights);
+#else
+      if (precisionMonitor) {
+        ctWeights = precisionMonitor->Bootstrap(cc, ctWeights);
+      } else if (params.btPrecision > 0) {
+        ctWeights = cc->EvalBootstrap(ctWeights, 2, params.btPrecision);
+      } else {
+        ctWeights = cc->EvalBootstrap(ctWeights);
+      }
+#endif
+    } else if (refresh) {
+      ReEncrypt(cc, ctWeights, shared.keys);
+    }
+
+    CT ctWeightsRotated = cc->EvalRotate(ctWeights, signedRowSize);
+    CT ctTheta = ThetaFromPackedWeights(cc, ctWeights, ctWeightsRotated, shared.ptExtractThetaMask,
+                                        shared.ptExtractPhiMask);
+    if (batchSchedule) {
+      batchShardIndices = batchSchedule->NextBatch();
+    }
+    EncLogRegCalculateGradient(cc, run.data, ctTheta, ctGradient, shared.rowKeys, shared.colKeys,
+                               shared.ptRowStartMask, shared.keys,
+                               *run.sigmoid, batchShardIndices, false, 0, params.hoistRadix);
+    ctWeights = PackedNagStep(cc, ctWeights, ctWeightsRotated, ctGradient, run.ptWeightsFactor,
+                              run.ptRotatedFactor, run.ptFirstGradientFactor, epochI == 0);
+
+    theta = DecryptTheta(cc, shared.keys, ctWeights, numFeatures);
+    loss = ComputeLoss(theta, shared.X, shared.y);
+    auto epochTime = TOC(t);
+    totalTime += epochTime;
+    run.lossOFS << epochI << ", " << epochTime << ", " << loss << std::endl;
+
+    std::stringstream ss;
+    ss << name << "Iteration " << epochI << (refresh ? " (refreshed)" : "") << ": loss " << loss << ", took "
+       << epochTime / 1000.0 << " s";
+    Log(ss.str());
+  }
+
+  auto testStats = ComputeLossAndAccuracy(theta, shared.testX, shared.testY);
+  run.result.trainLoss = loss;
+  run.result.testLoss = testStats.loss;
+  run.result.testAccuracy = testStats.accuracy;
+  run.result.refreshes = refreshSchedule.Refreshes();
+  run.result.seconds = totalTime / 1000.0;
+}
+
+} // namespace
+
+std::vector<SweepResult> RunSweep(
+    CC &cc,
+    const KeyPair &keys,
+    const MatKeys &rowKeys,
+    const MatKeys &colKeys,
+    const EncDataset &data,
+    const Mat &X,
+    const Mat &y,
+    const Mat &testX,
+    const Mat &testY,
+    const CryptoPlan &plan,
+    const Parameters &params,
+    const std::vector<SweepConfig> &configs,
+    double baseGradientScale
+) {
+  SweepShared shared{cc, keys, rowKeys, colKeys, X, y, testX, testY, plan, params, nullptr, nullptr, nullptr};
+  MakeWeightMasks(cc, data.rowSize, shared.ptExtractThetaMask, shared.ptExtractPhiMask);
+  MakeRowStartMask(cc, data.rowSize, shared.ptRowStartMask);
+  SigmoidFit sigmoidFit;
+  ParseSigmoidFit(params.sigmoidFit, sigmoidFit);
+  usint numSlots = data.rowSize * data.colSize;
+
+  // Everything a configuration needs besides the shared data is built here, on one thread: the
+  //    labels, the sigmoid fit, the NAG factors and the initial weights
+  std::vector<SweepRun> runs(configs.size());
+  for (usint i = 0; i < configs.size(); i++) {
+    auto &config = configs[i];
+    auto &run = runs[i];
+    run.result.config = config;
+
+    double labelFactor = config.lrGamma * (1 + config.lrEta) / baseGradientScale;
+    run.data = (labelFactor == 1.0) ? data : ScaleDatasetLabels(cc, data, y, labelFactor, keys,
+                                                                params.encryptThreads);
+    auto logitSamples = SampleNagLogits(X, y, params.numIters, config.lrGamma, config.lrEta);
+    run.sigmoid = std::make_unique<SigmoidEvaluator>(sigmoidFit, config.rangeStart, config.rangeEnd, config.degree,
+                                                     run.data.LabelScale(), logitSamples);
+    MakeNagStepFactors(cc, data.rowSize, config.lrEta, run.ptWeightsFactor, run.ptRotatedFactor,
+                       run.ptFirstGradientFactor);
+
+    // the weights start at zero: theta in the even blocks, (1 + eta) phi in the odd ones
+    Mat beta(data.numFeatures, 1);
+    run.ctWeights = collateOneDMats2CtVRC(cc, beta, beta, data.rowSize, numSlots, keys);
+
+    std::string lossFile = params.sweepOutPrefix + std::to_string(i) + "_loss.csv";
+    run.lossOFS.precision(params.outputPrecision);
+    run.lossOFS.open(lossFile, std::ofstream::out | std::ofstream::trunc);
+    if (!run.lossOFS.is_open()) {
+      OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+          std::to_string(__LINE__) + std::string("Error: could not open ") + lossFile);
+    }
+    run.lossOFS << "Iteration, Time Taken(ms), Train Loss" << std::endl;
+    std::cout << "[config " << i << "] lrGamma " << config.lrGamma << ", lrEta " << config.lrEta << ", degree "
+              << config.degree << " sigmoid over [" << config.rangeStart << ", " << config.rangeEnd
+              << "] (max error " << run.sigmoid->Error().maxError << "), labels scaled by " << labelFactor
+              << ", loss curve in " << lossFile << std::endl;
+  }
+
+  // one worker per configuration, each with its own weights. OpenFHE parallelizes inside every
+  //    operation too, so each worker's OpenMP team gets an equal share of the cores instead of all of them
+  int threadsPerConfig = std::max(1, static_cast<int>(std::thread::hardware_concurrency() / runs.size()));
+  std::vector<std::thread> workers;
+  std::vector<std::exception_ptr> errors(runs.size());
+  for (usint i = 0; i < runs.size(); i++) {
+    workers.emplace_back([&, i] {
+      omp_set_num_threads(threadsPerConfig);
+      try {
+        TrainConfig(shared, i, runs[i]);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  for (auto &error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  std::vector<SweepResult> results;
+  for (auto &run : runs) {
+    results.push_back(run.result);
+  }
+  return results;
+}
+
+void WriteSweepSummary(const std::vector<SweepResult> &results, const Parameters &params) {
+  std::string summaryFile = params.sweepOutPrefix + "summary.csv";
+  std::ofstream ofs(summaryFile, std::ofstream::out | std::ofstream::trunc);
+  if (!ofs.is_open()) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) + std::string("Error: could not open ") + summaryFile);
+  }
+  ofs.precision(params.outputPrecision);
+  ofs << "Config, lrGamma, lrEta, Range Start, Range End, Degree, Train Loss, Test Loss, Test Accuracy, "
+      << "Refreshes, Time Taken(s)" << std::endl;
+
+  std::cout << "Sweep summary (" << summaryFile << ")" << std::endl;
+  std::cout << std::left << std::setw(7) << "config" << std::setw(9) << "lrGamma" << std::setw(9) << "lrEta"
+            << std::setw(16) << "range" << std::setw(7) << "degree" << std::setw(12) << "train loss"
+            << std::setw(12) << "test loss" << std::setw(10) << "test acc" << std::setw(10) << "refreshes"
+            << "time (s)" << std::endl;
+  for (usint i = 0; i < results.size(); i++) {
+    auto &r = results[i];
+    auto &c = r.config;
+    ofs << i << ", " << c.lrGamma << ", " << c.lrEta << ", " << c.rangeStart << ", " << c.rangeEnd << ", "
+        << c.degree << ", " << r.trainLoss << ", " << r.testLoss << ", " << r.testAccuracy << ", "
+        << r.refreshes << ", " << r.seconds << std::endl;
+
+    std::stringstream range;
+    range << "[" << c.rangeStart << ", " << c.rangeEnd << "]";
+    std::cout << std::setw(7) << i << std::setw(9) << c.lrGamma << std::setw(9) << c.lrEta << std::setw(16)
+              << range.str() << std::setw(7) << c.degree << std::setw(12) << r.trainLoss << std::setw(12)
+              << r.testLoss << std::setw(10) << r.testAccuracy << std::setw(10) << r.refreshes << r.seconds
+              << std::endl;
+  }
+  std::cout << std::right;
+}
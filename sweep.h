@@ -0,0 +1,105 @@
+//==================================================================================
+// BSD 2-Clause License
+//
+// Copyright (c) 2023, Duality Technologies Inc.
+//
+// All rights reserved.
+//
+// Author TPOC: contact@openfhe.org
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef DPRIVE_ML__SWEEP_H_
+#define DPRIVE_ML__SWEEP_H_
+
+#include <string>
+#include <vector>
+#include "openfhe.h"
+#include "crypto_planner.h"
+#include "enc_dataset.h"
+#include "lr_types.h"
+#include "parameters.h"
+
+////////// Training several hyperparameter configurations at once ///////////////////////////////
+
+/* A sweep over the learning rate, the momentum and the sigmoid range/degree used to mean
+ * recompiling lr_nag and repeating key generation, bootstrapping setup and encryption per
+ * configuration. In a sweep one process trains every configuration concurrently, one worker
+ * thread each, sharing the context, the keys and the encrypted X and -X':
+ *    - -X' is encrypted once for the default learning rate. A configuration whose
+ *      lrGamma * (1 + lrEta) differs gets its own copy of the labels, scaled by the ratio, with
+ *      the sigmoid scaled the same way (see ScaleDatasetLabels)
+ *    - the depth is planned for the deepest sigmoid and the dataset levels for the shallowest,
+ *      like the adaptive sigmoid, and each configuration refreshes its own weights when its
+ *      iterations need it
+ * Each configuration writes its loss curve to <prefix><i>_loss.csv, and the sweep ends with a
+ * summary table, also written to <prefix>summary.csv.
+ */
+struct SweepConfig {
+  float lrGamma = 0;
+  float lrEta = 0;
+  double rangeStart = 0;
+  double rangeEnd = 0;
+  usint degree = 0;
+};
+
+struct SweepResult {
+  SweepConfig config;
+  double trainLoss = 0;
+  double testLoss = 0;
+  double testAccuracy = 0;
+  usint refreshes = 0;
+  double seconds = 0;
+};
+
+// Reads one configuration per line: lrGamma lrEta [rangeStart rangeEnd [degree]], separated by
+//    spaces or commas. Missing fields (and a degree of 0) are taken from defaults, blank lines and
+//    lines starting with # are skipped. Throws on malformed lines or an empty sweep
+std::vector<SweepConfig> ReadSweepConfigs(const std::string &path, const SweepConfig &defaults);
+
+/**
+ * Trains every configuration for params.numIters iterations, see above
+ * @param data              dataset encrypted with -X' scaled for baseGradientScale
+ * @param X, y              the plaintext training set data was encrypted from, for the labels and the losses
+ * @param plan              the plan the context was made from, its depth covers every configuration
+ * @param baseGradientScale lrGamma * (1 + lrEta) data was encrypted for
+ */
+std::vector<SweepResult> RunSweep(
+    CC &cc,
+    const KeyPair &keys,
+    const MatKeys &rowKeys,
+    const MatKeys &colKeys,
+    const EncDataset &data,
+    const Mat &X,
+    const Mat &y,
+    const Mat &testX,
+    const Mat &testY,
+    const CryptoPlan &plan,
+    const Parameters &params,
+    const std::vector<SweepConfig> &configs,
+    double baseGradientScale
+);
+
+// prints the results as a table and writes them to <params.sweepOutPrefix>summary.csv
+void WriteSweepSummary(const std::vector<SweepResult> &results, const Parameters &params);
+
+#endif //DPRIVE_ML__SWEEP_H_
@@ -64,32 +64,35 @@ std::pair<usint, usint> ComputePaddedDimensions(const usint numRows, const usint
 }
 
 /////////////////////////////////
-Vec Mat2MatRowMajorVec(const Mat &inMat) {
+Vec Mat2MatRowMajorVec(MatView inMat) {
   //matrix row major { row 0, row 1, etc}
   //verified
-  usint numRows = inMat.size();
-  usint numCols = inMat[0].size();
+  usint numRows = inMat.NumRows();
+  usint numCols = inMat.NumCols();
   OPENFHE_DEBUG_FLAG(false);
   OPENFHE_DEBUGEXP(numRows);
   OPENFHE_DEBUGEXP(numCols);
-  Vec outVec;
-  //yes this is slow...
+  Vec outVec(numRows * numCols);
+  // one copy per row; a single copy when the rows of the view are back to back
+  if (inMat.RowsContiguous() && (inMat.RowStride() == numCols || numRows == 1)) {
+    std::copy_n(inMat.Data(), outVec.size(), outVec.begin());
+    return outVec;
+  }
   for (usint i = 0; i < numRows; i++) {
     for (usint j = 0; j < numCols; j++) {
-      outVec.push_back(inMat[i][j]);
-      OPENFHE_DEBUGEXP(inMat[i][j]);
+      outVec[i * numCols + j] = inMat(i, j);
     }
   }
   return outVec;
 }
 
 /////////////////////////////////
-Vec OneDMat2Vec(const Mat &inMat) {
+Vec OneDMat2Vec(MatView inMat) {
   //matrix row major { row 0, row 1, etc}
 
   OPENFHE_DEBUG_FLAG(false);
-  usint numRows = inMat.size();
-  usint numCols = inMat[0].size();
+  usint numRows = inMat.NumRows();
+  usint numCols = inMat.NumCols();
 
   OPENFHE_DEBUGEXP(numRows);
   OPENFHE_DEBUGEXP(numCols);
@@ -113,10 +116,18 @@ Vec OneDMat2Vec(const Mat &inMat) {
 }
 
 ///////////////////////////////////////////////////////////
-CT OneDMat2CtVCC(CC &cc, const Mat &inMat, const int rowSize, const int numSlots, const KeyPair &keys) {
+CT OneDMat2CtVCC(CC &cc, MatView inMat, const int rowSize, const int numSlots, const KeyPair &keys) {
+  // make plaintext
+  PT inVecCCPT = cc->MakeCKKSPackedPlaintext(PackVecColCloned(inMat, rowSize, numSlots)); // encode cloned vector
+  //encrypt
+  CT ctin = cc->Encrypt(keys.publicKey, inVecCCPT);
+  return ctin;
+}
+
+Vec PackVecColCloned(MatView inMat, const int rowSize, const int numSlots) {
   //verifired
   OPENFHE_DEBUG_FLAG(false);
-  OPENFHE_DEBUG("in OneDMat2CtVCC");
+  OPENFHE_DEBUG("in PackVecColCloned");
   // input is currently a Mat (row vector) use Mat2Vec to make it a vector
   auto inVec = OneDMat2Vec(inMat);
 
@@ -149,11 +160,7 @@ CT OneDMat2CtVCC(CC &cc, const Mat &inMat, const int rowSize, const int numSlots
 //  if (dbg_flag) {
 //    PrintVecColCloned(inVecCC, colSize);
 //  }
-  // make plaintext
-  PT inVecCCPT = cc->MakeCKKSPackedPlaintext(inVecCC); // encode cloned vector
-  //encrypt
-  CT ctin = cc->Encrypt(keys.publicKey, inVecCCPT);
-  return ctin;
+  return inVecCC;
 }
 
 //CT OneDMat2CtVRC(CC &cc, const Mat &inMat, const int rowSize, const int numSlots, const KeyPair &keys) {
@@ -199,7 +206,7 @@ Vec cloneVecRc(const Mat &inMat, const int rowSize, const int numSlots){
 }
 
 CT collateOneDMats2CtVRC(CC &cc, const Mat &inMat, const Mat &inMat2, const int rowSize, const int numSlots, const KeyPair &keys) {
-  if (inMat2.size() != inMat.size() || inMat2[0].size() != inMat[0].size()){
+  if (inMat2.NumRows() != inMat.NumRows() || inMat2.NumCols() != inMat.NumCols()){
     OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
         std::to_string(__LINE__) +
         std::string("Error: 1D-Matrices to collate are not of the same size!"));
@@ -223,15 +230,50 @@ CT collateOneDMats2CtVRC(CC &cc, const Mat &inMat, const Mat &inMat2, const int
 }
 
 ///////////////////////////////////////////////////////////
-CT Mat2CtMRM(CC &cc, const Mat &inMat, const int rowSize, const int numSlots, const KeyPair &keys) {
+CT Mat2CtMRM(CC &cc, MatView inMat, const int rowSize, const int numSlots, const KeyPair &keys) {
+  PT inPT = cc->MakeCKKSPackedPlaintext(PackMatRowMajor(inMat, rowSize, numSlots)); // encode inPT plaintext matrix
+  auto ctin = cc->Encrypt(keys.publicKey, inPT); //ciphertext in
+  return ctin;
+}
+
+std::vector<Vec> PackMatDiagonals(MatView inMat, const usint rowSize, const usint numSlots, bool transposed) {
+  usint numRows = inMat.NumRows();
+  usint numCols = inMat.NumCols();
+  if (numRows > numSlots || numCols > rowSize || numSlots % rowSize != 0) {
+    OPENFHE_THROW(lbcrypto::config_error, __FILE__ + std::string(" ") + __FUNCTION__ + std::string(":") +
+        std::to_string(__LINE__) +
+        std::string("Error: input matrix does not fit numSlots x rowSize"));
+  }
+  usint babySteps = BsgsBabySteps(rowSize);
+
+  std::vector<Vec> diags(rowSize, Vec(numSlots, 0.0));
+#pragma omp parallel for
+  for (usint i = 0; i < rowSize; i++) {
+    usint a = i / babySteps;
+    usint b = i % babySteps;
+    // sample s = blk * rowSize + j of diagonal i is column (j + i) % rowSize, or (j - i) % rowSize
+    //    for the transposed product. It is stored at s + a * g (forward) or s - b (transposed)
+    usint shift = transposed ? numSlots - b : a * babySteps;
+    usint colOffset = transposed ? rowSize - i : i;
+    for (usint s = 0; s < numRows; s++) {
+      usint col = (s % rowSize + colOffset) % rowSize;
+      if (col < numCols) {
+        diags[i][(s + shift) % numSlots] = inMat(s, col);
+      }
+    }
+  }
+  return diags;
+}
+
+Vec PackMatRowMajor(MatView inMat, const int rowSize, const int numSlots) {
   // inMat is to be used in a MatrixVectorProductRow so needs to be encrypted as MAT_ROW_MAJOR nfp x nsp
-  // inMat is currently a Mat: vector nrows long of vectors (ncol long)
+  // inMat is a view of a row-major Mat: nrows rows of ncol elements
   // so this storage requirement is differnt, instead of rowSize as a limit this packed with colSize as the width limit.
 
   OPENFHE_DEBUG_FLAG(false);
-  OPENFHE_DEBUG("in Mat2CtMRM");
-  int origNumRows = inMat.size();     //n_samp (note transposed)
-  int origNumCols = inMat[0].size();  //n_feat (including the intecept column)
+  OPENFHE_DEBUG("in PackMatRowMajor");
+  int origNumRows = inMat.NumRows();     //n_samp (note transposed)
+  int origNumCols = inMat.NumCols();  //n_feat (including the intecept column)
 
   auto numCols = rowSize; //note this is the bigger dimension
   auto numRows = numSlots / numCols;
@@ -255,23 +297,14 @@ CT Mat2CtMRM(CC &cc, const Mat &inMat, const int rowSize, const int numSlots, co
   //  copy matrix to a new array, zero padding rows and columns out to rowSize and columnSize
   Vec inRMZP(numSlots, 0.0); //row major zero padded Note full vector created set to zeros
 
-  auto k = 0; //index into vector to write
-  auto i = 0;
-  for (; i < origNumRows; i++) {
-    auto j = 0;
-    for (; j < origNumCols; j++) {
-      inRMZP[k] = inMat[i][j]; //fill in a row with data
-      k++;
-    }
-    for (; j < numCols; j++) { // fill in rest of row with zeros
-      k++;
-    }
-  }
-
-  for (; i < numRows; i++) { //fill in zero rows
-    for (auto j = 0; j < numCols; j++) {
-      inRMZP[k] = 0.0; //fill in a row with data
-      k++;
+  // strided copy: row i of inMat lands at slot i * numCols, the padding is already zero
+  for (auto i = 0; i < origNumRows; i++) {
+    if (inMat.RowsContiguous()) {
+      std::copy_n(&inMat(i, 0), origNumCols, inRMZP.begin() + i * numCols);
+    } else {
+      for (auto j = 0; j < origNumCols; j++) {
+        inRMZP[i * numCols + j] = inMat(i, j);
+      }
     }
   }
   OPENFHE_DEBUGEXP(inRMZP.size());
@@ -282,27 +315,17 @@ CT Mat2CtMRM(CC &cc, const Mat &inMat, const int rowSize, const int numSlots, co
 //  if (dbg_flag) {
 //    PrintMatRowMajor(inRMZP, numCols);  //need to verify
 //  }
-  PT inPT = cc->MakeCKKSPackedPlaintext(inRMZP); // encode inPT plaintext matrix
-  auto ctin = cc->Encrypt(keys.publicKey, inPT); //ciphertext in
-  return ctin;
+  return inRMZP;
 }
 
-void populateData(
+void LoadTrainData(
     Parameters &params,
-    CC &cc,
-    KeyPair &keys,
-    Mat &NegXt,
-    Mat &beta,
     Mat &X,
     Mat &y,
     Mat &testX,
-    Mat &testY,
-    PT &ptExtractThetaMask,
-    PT &ptExtractPhiMask,
-    float lrGamma
+    Mat &testY
     ){
 
-  usint numSlots = cc->GetEncodingParams()->GetBatchSize();
   /////////////////////////////////////////////////////////
   // Load inputs and set up the problem
   /////////////////////////////////////////////////////////
@@ -318,31 +341,39 @@ void populateData(
 
   bool normalizeFlag(false); //should this be a command line parameter?
   LoadDataFile(params.trainXFile, X, featureNames, params.rowsToRead, normalizeFlag);
-  LoadDataFile(params.testXFile, testX, featureNames, params.rowsToRead, normalizeFlag);
   // We never normalize the labels.
   LoadDataFile(params.trainYFile, y, labelNames, params.rowsToRead, false);
-  LoadDataFile(params.testYFile, testY, labelNames, params.rowsToRead, false);
-
-  //determine dimensions for matrix encryptions
-  usint originalNumSamp = X.size();     //n_samp
-  usint originalNumFeat = X[0].size();  //n_feat (including the intecept column
+  LoadTestData(params, testX, testY);
 
-  if (X.size() != y.size() || testX.size() != testY.size()) {
+  if (X.NumRows() != y.NumRows()) {
     std::cerr << " X and y dimension mismatch!" << std::endl;
     exit(EXIT_FAILURE);
   }
 
 #ifdef ENABLE_DEBUG
   std::cout << "Original Training data set size (r x c): "
-            << originalNumSamp << " x " << originalNumFeat << std::endl;
+            << X.NumRows() << " x " << X.NumCols() << std::endl;
   std::cout << "First row of training set (for sanity check): " << std::endl;
   SimplePrintVec("SMALL_SCALE: First X: ", X[0]);
   std::cout << std::endl;
-  std::cout << "Training labels size " << y.size() << " x 1" << std::endl;
+  std::cout << "Training labels size " << y.NumRows() << " x 1" << std::endl;
   std::cout << "First label of training set (for sanity check): " << std::endl;
   SimplePrintVec("SMALL_SCALE: First y: ", y[0]);
   std::cout << std::endl;
 #endif // ENABLE_DEBUG
+}
+
+void populateData(
+    Parameters &params,
+    usint numSlots,
+    Mat &NegXt,
+    Mat &beta,
+    Mat &X,
+    Mat &y,
+    float lrGamma
+    ){
+  usint originalNumSamp = X.NumRows();     //n_samp
+  usint originalNumFeat = X.NumCols();  //n_feat (including the intecept column
 
 //////////////////////////////////////////////////////
   // Encode and encrypt input data
@@ -364,11 +395,6 @@ void populateData(
   auto dims = ComputePaddedDimensions(originalNumSamp, originalNumFeat, numSlots);
   usint colSize = dims.first;
   usint rowSize = dims.second;
-  int signedRowSize = (int) rowSize;
-
-  std::vector<int> rotationIndices = {-signedRowSize, signedRowSize};
-  std::cout << "\tEvalRotate keys" << std::endl;
-  cc->EvalRotateKeyGen(keys.secretKey, rotationIndices);
 
   std::cout << "colSize x rowSize = " << colSize << " * " << rowSize << " = " << colSize * rowSize << std::endl;
 
@@ -388,9 +414,9 @@ void populateData(
   usint nrow2print(4); //print 4 rows or columns for sanity
   std::cout << "Initialized data: " << std::endl;
   std::cout << "X (showing only " << nrow2print << " rows): " << std::endl;
-  PrintSubmatrix(X, nrow2print, X[0].size());
+  PrintSubmatrix(X, nrow2print, X.NumCols());
   std::cout << "NegXt (showing only " << nrow2print << " col): " << std::endl;
-  PrintSubmatrix(NegXt, X.size(), nrow2print);
+  PrintSubmatrix(NegXt, X.NumRows(), nrow2print);
   std::cout << "beta: " << std::endl;
   PrintMatrix(beta);
   std::cout << std::endl;
@@ -406,25 +432,145 @@ void populateData(
   // both use the same packing.
 
   // - Weight vector beta n_features x 1 (col vector)
-  beta = Mat(originalNumFeat, Vec(1, 0.0));
-
-  {
-    Vec thetaMask = Vec(numSlots, 0);
-    Vec phiMask = Vec(numSlots, 0);
-    for (uint i = 0; i < numSlots; i++) {
-      if ((i / rowSize) % 2 == 0) {
-        thetaMask[i] = 1;
-      } else {
-        phiMask[i] = 1;
+  beta = Mat(originalNumFeat, 1);
+
+  // single-X mode never encrypts NegXt, so skip building the scaled copy
+  if (!params.singleX) {
+    auto layout = ResolveMatVecLayout(params, originalNumSamp, originalNumFeat, numSlots);
+    usint shardCapacity = ShardCapacity(layout, rowSize, numSlots);
+    NegXt = InitializeLogReg(X, y, ComputeNegXtScale(params, originalNumSamp, shardCapacity, lrGamma));
+
+    // a mini-batch holding the partial last shard would otherwise take a step scaled by its few rows
+    double tailScale = ComputeTailShardScale(params, originalNumSamp, shardCapacity);
+    if (tailScale != 1.0) {
+      usint shardRows = ResolveShardRows(params, shardCapacity);
+      usint tailStart = originalNumSamp - originalNumSamp % shardRows;
+      auto negXt = NegXt.Data();
+      for (size_t k = size_t(tailStart) * NegXt.NumCols(); k < NegXt.NumElements(); k++) {
+        negXt[k] *= tailScale;
       }
     }
-    ptExtractThetaMask = cc->MakeCKKSPackedPlaintext(thetaMask);
-    ptExtractPhiMask = cc->MakeCKKSPackedPlaintext(phiMask);
   }
-  NegXt = InitializeLogReg(X, y, lrGamma / y.size());
 
 }
 
+void LoadTestData(Parameters &params, Mat &testX, Mat &testY) {
+  std::vector<std::string> featureNames;
+  std::vector<std::string> labelNames;
+
+  LoadDataFile(params.testXFile, testX, featureNames, params.rowsToRead, false);
+  // We never normalize the labels.
+  LoadDataFile(params.testYFile, testY, labelNames, params.rowsToRead, false);
+
+  if (testX.NumRows() != testY.NumRows()) {
+    std::cerr << " testX and testY dimension mismatch!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+usint ResolveShardRows(const Parameters &params, usint shardCapacity) {
+  return (params.shardRows == 0) ? shardCapacity : params.shardRows;
+}
+
+double ComputeNegXtScale(const Parameters &params, usint numSamples, usint shardCapacity, float lrGamma) {
+  // In mini-batch mode an iteration only sees batchShards shards, so -X' is pre-scaled by the
+  //    rows in a batch instead of by every sample. A partial last shard counts as a full one, its
+  //    rows are scaled up by ComputeTailShardScale
+  usint shardRows = ResolveShardRows(params, shardCapacity);
+  usint batchRows = (params.batchShards == 0) ? numSamples : std::min(numSamples, params.batchShards * shardRows);
+  return lrGamma / batchRows;
+}
+
+double ComputeTailShardScale(const Parameters &params, usint numSamples, usint shardCapacity) {
+  usint shardRows = ResolveShardRows(params, shardCapacity);
+  usint tailRows = numSamples % shardRows;
+  if (params.batchShards == 0 || params.batchShards >= ComputeNumShards(numSamples, shardRows) || tailRows == 0) {
+    return 1.0;
+  }
+  return double(shardRows) / tailRows;
+}
+
+MatVecLayout ResolveMatVecLayout(const Parameters &params, usint numSamples, usint numFeatures, usint numSlots) {
+  if (params.matVecLayout == "row") {
+    return MatVecLayout::ROW_MAJOR;
+  }
+  if (params.matVecLayout == "diag") {
+    return MatVecLayout::DIAGONAL;
+  }
+  // a single copy of X only works with the row-major products
+  if (params.singleX) {
+    return MatVecLayout::ROW_MAJOR;
+  }
+  return ChooseMatVecLayout(numSamples, NextPow2(numFeatures), numSlots, params.hoistRadix);
+}
+
+usint ShardCapacity(MatVecLayout layout, usint rowSize, usint numSlots) {
+  return (layout == MatVecLayout::DIAGONAL) ? numSlots : numSlots / rowSize;
+}
+
+void MakeWeightMasks(
+    CC &cc,
+    usint rowSize,
+    PT &ptExtractThetaMask,
+    PT &ptExtractPhiMask
+    ){
+  usint numSlots = cc->GetEncodingParams()->GetBatchSize();
+  Vec thetaMask = Vec(numSlots, 0);
+  Vec phiMask = Vec(numSlots, 0);
+  for (uint i = 0; i < numSlots; i++) {
+    if ((i / rowSize) % 2 == 0) {
+      thetaMask[i] = 1;
+    } else {
+      phiMask[i] = 1;
+    }
+  }
+  ptExtractThetaMask = cc->MakeCKKSPackedPlaintext(thetaMask);
+  ptExtractPhiMask = cc->MakeCKKSPackedPlaintext(phiMask);
+}
+
+void MakeRowStartMask(
+    CC &cc,
+    usint rowSize,
+    PT &ptRowStartMask
+    ){
+  usint numSlots = cc->GetEncodingParams()->GetBatchSize();
+  Vec mask = Vec(numSlots, 0);
+  for (uint i = 0; i < numSlots; i += rowSize) {
+    mask[i] = 1;
+  }
+  ptRowStartMask = cc->MakeCKKSPackedPlaintext(mask);
+}
+
+void MakeNagStepFactors(
+    CC &cc,
+    usint rowSize,
+    double eta,
+    PT &ptWeightsFactor,
+    PT &ptRotatedFactor,
+    PT &ptFirstGradientFactor
+    ){
+  usint numSlots = cc->GetEncodingParams()->GetBatchSize();
+  Vec weightsFactor = Vec(numSlots, 0);
+  Vec rotatedFactor = Vec(numSlots, 0);
+  Vec firstGradientFactor = Vec(numSlots, 0);
+  for (uint i = 0; i < numSlots; i++) {
+    if ((i / rowSize) % 2 == 0) {
+      // theta block: theta' = (1 + eta) theta - eta / (1 + eta) * ((1 + eta) phi) - grad
+      weightsFactor[i] = 1 + eta;
+      rotatedFactor[i] = -eta / (1 + eta);
+      firstGradientFactor[i] = 1 / (1 + eta);
+    } else {
+      // (1 + eta) phi block: (1 + eta) phi' = (1 + eta) theta - grad
+      weightsFactor[i] = 0;
+      rotatedFactor[i] = 1 + eta;
+      firstGradientFactor[i] = 1;
+    }
+  }
+  ptWeightsFactor = cc->MakeCKKSPackedPlaintext(weightsFactor);
+  ptRotatedFactor = cc->MakeCKKSPackedPlaintext(rotatedFactor);
+  ptFirstGradientFactor = cc->MakeCKKSPackedPlaintext(firstGradientFactor);
+}
+
 ////////////////////////////////////////////////////////////////////
 // Utility print functinons
 void PrintVecRowCloned(const Vec &z, const int rowSize) {
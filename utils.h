@@ -67,22 +67,34 @@ std::pair<usint, usint> ComputePaddedDimensions(const usint numRows, const usint
 //not sure where these functions will end up
 //
 //!todo clean up do we need single vector in Mat_row_major or mat_col_major? arent they the same thing for a single vector?
-// converts Mat input (vector of vectors representation) to single vector MAT_ROW_MAJOR representation.
-Vec Mat2MatRowMajorVec(const Mat &inMat);
+// converts Mat input (or a view of one) to single vector MAT_ROW_MAJOR representation.
+Vec Mat2MatRowMajorVec(MatView inMat);
 
-// converts Mat input (vector of vectors representation) of a column or row vector to single vector
-Vec OneDMat2Vec(const Mat &inMat);
+// converts Mat input (or a view of one) of a column or row vector to single vector
+Vec OneDMat2Vec(MatView inMat);
 
 ///////////////////////////////////////////////////////////
 // encode and encrypt a Mat into Ciphertext in MAT_ROW_MAJOR format with zero padding
 // note these functions DO apply zero padding
-CT Mat2CtMRM(CC &cc, const Mat &inMat, const int rowSize, const int numSlots, const KeyPair &keys);
+CT Mat2CtMRM(CC &cc, MatView inMat, const int rowSize, const int numSlots, const KeyPair &keys);
+
+// the MAT_ROW_MAJOR zero padded slot vector Mat2CtMRM encrypts
+Vec PackMatRowMajor(MatView inMat, const int rowSize, const int numSlots);
 
 ///////////////////////////////////////////////////////////
 //  encode and encrypt a One Dimensional Mat into Ciphertext in VEC_COL_CLONED format
 // zero padded out to rowSize, the power of 2 dimension, then cloned to
 // fill out numSlots
-CT OneDMat2CtVCC(CC &cc, const Mat &inMat, const int rowSize, const int numSlots, const KeyPair &keys);
+CT OneDMat2CtVCC(CC &cc, MatView inMat, const int rowSize, const int numSlots, const KeyPair &keys);
+
+// the VEC_COL_CLONED slot vector OneDMat2CtVCC encrypts
+Vec PackVecColCloned(MatView inMat, const int rowSize, const int numSlots);
+
+///////////////////////////////////////////////////////////
+// the rowSize diagonal slot vectors of inMat (at most numSlots rows, at most rowSize columns) for
+// MatrixVectorProductDiag, or with transposed for MatrixTransposeVectorProductDiag. Each is
+// pre-rotated for its baby-step giant-step position (see enc_matrix.h) and zero padded
+std::vector<Vec> PackMatDiagonals(MatView inMat, const usint rowSize, const usint numSlots, bool transposed);
 
 ///////////////////////////////////////////////////////////
 
@@ -109,19 +121,83 @@ void SimplePrintVec(const std::string prefixMsg, const T &vec) {
   std::cout << std::endl;
 }
 
+///////////////////////////////////////////////////////////////
+// Loads the train and test sets. Runs before the crypto parameters are planned, which
+// depend on the shape of X
+void LoadTrainData(
+    Parameters &params,
+    Mat &X,
+    Mat &y,
+    Mat &testX,
+    Mat &testY
+);
+
+///////////////////////////////////////////////////////////////
+// Initializes beta to zeros and builds the pre-scaled NegXt from the loaded X and y.
+// Runs entirely in the clear so it can happen before the crypto context exists.
 void populateData(
     Parameters &params,
-    CC &cc,
-    KeyPair &keys,
+    usint numSlots,
     Mat &NegXt,
     Mat &beta,
     Mat &X,
     Mat &y,
-    Mat &testX,
-    Mat &testY,
-    PT &ptExtractThetaMask,
-    PT &ptExtractPhiMask,
     float lrGamma
 );
 
+///////////////////////////////////////////////////////////////
+// Loads the test set used for the test loss
+void LoadTestData(Parameters &params, Mat &testX, Mat &testY);
+
+///////////////////////////////////////////////////////////////
+// returns the rows per shard: -c, or shardCapacity (see ShardCapacity) when it is 0
+usint ResolveShardRows(const Parameters &params, usint shardCapacity);
+
+// returns the factor -X' is pre-scaled by: lrGamma / (rows seen per iteration).
+// shardCapacity is the number of samples a shard holds by default (see ShardCapacity)
+double ComputeNegXtScale(const Parameters &params, usint numSamples, usint shardCapacity, float lrGamma);
+
+// returns the factor the rows of a partial last shard of -X' are scaled by on top of
+// ComputeNegXtScale: shardRows / tailRows in mini-batch mode, so that shard takes a step as large
+// as a full one, and 1 when every shard is full or every iteration sees every shard
+double ComputeTailShardScale(const Parameters &params, usint numSamples, usint shardCapacity);
+
+///////////////////////////////////////////////////////////////
+// the matrix-vector layout of this run: the one forced with -L, otherwise the cheaper one for the data
+MatVecLayout ResolveMatVecLayout(const Parameters &params, usint numSamples, usint numFeatures, usint numSlots);
+
+// samples a shard holds at most: a MAT_ROW_MAJOR ciphertext's rows, or a slot per sample for the diagonal layout
+usint ShardCapacity(MatVecLayout layout, usint rowSize, usint numSlots);
+
+///////////////////////////////////////////////////////////////
+// Builds the masks that separate theta (even rowSize blocks) from phi (odd rowSize blocks)
+// in the packed weights ciphertext
+void MakeWeightMasks(
+    CC &cc,
+    usint rowSize,
+    PT &ptExtractThetaMask,
+    PT &ptExtractPhiMask
+);
+
+///////////////////////////////////////////////////////////////
+// Builds the mask that keeps the first slot of every rowSize-wide row, used by HoistedSumCols
+void MakeRowStartMask(
+    CC &cc,
+    usint rowSize,
+    PT &ptRowStartMask
+);
+
+///////////////////////////////////////////////////////////////
+// Builds the per-block factors of the packed NAG step (see PackedNagStep) for momentum eta:
+// the factors of the weights and of the weights rotated by rowSize, and the factor of the
+// scaled gradient in the first iteration (which has no momentum yet)
+void MakeNagStepFactors(
+    CC &cc,
+    usint rowSize,
+    double eta,
+    PT &ptWeightsFactor,
+    PT &ptRotatedFactor,
+    PT &ptFirstGradientFactor
+);
+
 #endif //DPRIVE_ML__UTILS_H_